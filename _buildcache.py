@@ -0,0 +1,79 @@
+"""Builds the extension in place when importing the repository, unless the last build used the same sources.
+
+The cache key is a hash of sources and depends of setup.py, setup.py itself, the build profile and the Python build.
+"""
+
+import contextlib
+import hashlib
+import importlib.util
+import os
+import pathlib
+import subprocess
+import sys
+import sysconfig
+import time
+
+root_dir = pathlib.Path(__file__).parent.resolve()
+lock_file = root_dir / 'build' / 'pyevermizer-build.lock'
+
+
+def source_hash():
+    # setup.py only imports setuptools when run as script
+    spec = importlib.util.spec_from_file_location('_pyevermizer_setup', root_dir / 'setup.py')
+    setup = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(setup)
+    h = hashlib.sha256()
+    h.update(f'{sys.version}\0{sysconfig.get_config_var("EXT_SUFFIX")}\0{setup.build_profile}\0'.encode())
+    for path in sorted(set(map(pathlib.Path, [*setup.sources, *setup.depends, 'setup.py']))):
+        try:
+            data = (root_dir / path).read_bytes()
+        except FileNotFoundError:
+            data = None  # i.e. gourds.csv without submodule. let the build report it
+        h.update(f'{path.as_posix()}\0{-1 if data is None else len(data)}\0'.encode())
+        h.update(data or b'')
+    return h.hexdigest()
+
+
+def try_lock(f):
+    try:
+        if os.name == 'nt':
+            import msvcrt
+            msvcrt.locking(f.fileno(), msvcrt.LK_NBLCK, 1)
+        else:
+            import fcntl
+            fcntl.flock(f.fileno(), fcntl.LOCK_EX | fcntl.LOCK_NB)
+        return True
+    except OSError:
+        return False
+
+
+@contextlib.contextmanager
+def build_lock(timeout=600):
+    """OS file lock, so parallel imports don't build over each other. it is released when the holder dies"""
+    lock_file.parent.mkdir(exist_ok=True)
+    deadline = time.monotonic() + timeout
+    with open(lock_file, 'a+b') as f:
+        while not try_lock(f):
+            if time.monotonic() > deadline:
+                raise TimeoutError(f'{lock_file} is held for too long by a running build')
+            time.sleep(0.1)
+        yield  # closing the file releases the lock
+
+
+def build_ext_cached():
+    """Run build_ext in place if sources changed since the last build. Returns True if it ran"""
+    ext = root_dir / 'src' / ('_evermizer' + sysconfig.get_config_var('EXT_SUFFIX'))
+    stamp = root_dir / 'build' / (ext.name + '.sha256')
+    digest = source_hash()
+    if ext.exists() and stamp.exists() and stamp.read_text().strip() == digest:
+        return False
+    with build_lock():
+        if ext.exists() and stamp.exists() and stamp.read_text().strip() == digest:
+            return False  # built by someone else while waiting
+        if stamp.exists():
+            stamp.unlink()
+        subprocess.run([sys.executable, 'setup.py', 'build_ext', '--inplace'], cwd=root_dir, check=True)
+        tmp = stamp.with_suffix('.tmp')
+        tmp.write_text(digest + '\n')
+        os.replace(tmp, stamp)
+        return True
@@ -3,7 +3,7 @@ import sys as _sys
 import cppyy as _cppy
 
 _cppy.include(pathlib.Path(__file__).parent.resolve() / 'src' / '_evermizer.c')
-_sys.modules['pyevermizer.src._evermizer'] = _cppy.gbl.PyInit__evermizer()
+_sys.modules['pyevermizer.src._evermizer'] = _cppy.gbl._evermizer_create_module('pyevermizer.src._evermizer')
 from .src import *
 
 print('Running evermizer from c source')
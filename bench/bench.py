@@ -0,0 +1,173 @@
+"""Benchmarks for pyevermizer: import time, get_* latency and ROM generation throughput.
+
+Generation needs a vanilla ROM via --rom, or --synthetic to explicitly run against the synthetic stand-in of
+synthrom.py. Results are printed as JSON, use --output to write them to a file and --baseline to compare.
+"""
+
+import argparse
+import json
+import os
+import pathlib
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+bench_dir = pathlib.Path(__file__).parent.absolute()
+sys.path.insert(0, str(bench_dir))
+
+import synthrom  # noqa: E402
+
+GETTERS = ('get_locations', 'get_sniff_locations', 'get_items', 'get_sniff_items', 'get_extra_items',
+           'get_traps', 'get_logic')
+SETTINGS = ('bench', 'slot', 'r', 0, 0, [])  # apseed, apslot, flags, money, exp, switches
+
+
+def summarize(samples):
+    return {
+        'runs': len(samples),
+        'median_s': statistics.median(samples),
+        'min_s': min(samples),
+        'max_s': max(samples),
+    }
+
+
+def timed(func, repeat):
+    samples = []
+    for _ in range(repeat):
+        t = time.perf_counter()
+        func()
+        samples.append(time.perf_counter() - t)
+    return samples
+
+
+def bench_import(repeat):
+    """import pyevermizer in a fresh interpreter, measured in that interpreter"""
+    code = 'import time; t = time.perf_counter(); import pyevermizer; print(time.perf_counter() - t)'
+    samples = []
+    for _ in range(repeat):
+        out = subprocess.run([sys.executable, '-c', code], check=True, stdout=subprocess.PIPE)
+        samples.append(float(out.stdout.decode().strip().splitlines()[-1]))
+    return summarize(samples)
+
+
+def bench_getters(evermizer, repeat):
+    results = {}
+    for name in GETTERS:
+        getter = getattr(evermizer, name)
+        results[name + '(copy=True)'] = summarize(timed(lambda: getter(copy=True), repeat))
+        getter()  # fill cache
+        results[name] = summarize(timed(getter, repeat))
+    return results
+
+
+def bench_generation(evermizer, rom, repeat, jobs):
+    results = {}
+    handle = evermizer.load_rom(rom)
+    with tempfile.TemporaryDirectory() as tmp:
+        src = os.path.join(tmp, 'src.sfc')
+        with open(src, 'wb') as f:
+            f.write(rom)
+        seeds = iter(range(1_000_000))
+
+        def run_main(dst):
+            res = evermizer.main(src, dst, [], SETTINGS[0], SETTINGS[1], next(seeds), *SETTINGS[2:])
+            if res != 0:
+                raise RuntimeError(f'main() failed with code {res}')
+
+        def run_threads():
+            errors = [None] * jobs
+
+            def work(i):
+                try:
+                    run_main(os.path.join(tmp, f'out{i}.sfc'))
+                except BaseException as ex:
+                    errors[i] = ex
+
+            threads = [threading.Thread(target=work, args=(i,)) for i in range(jobs)]
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+            for error in errors:
+                if error is not None:
+                    raise error
+
+        def run_many():
+            results_ = evermizer.generate_many([(handle, [], SETTINGS[0], SETTINGS[1], next(seeds), *SETTINGS[2:])
+                                                for _ in range(jobs)])
+            errors = [r for r in results_ if isinstance(r, Exception)]
+            if errors:
+                raise errors[0]
+
+        samples = timed(lambda: run_main(os.path.join(tmp, 'out.sfc')), repeat)
+        results['main'] = summarize(samples)
+        samples = timed(lambda: evermizer.generate(handle, [], SETTINGS[0], SETTINGS[1], next(seeds),
+                                                   *SETTINGS[2:]), repeat)
+        results['generate'] = summarize(samples)
+        for name, func in (('main', run_threads), ('generate_many', run_many)):
+            samples = timed(func, repeat)
+            res = summarize(samples)
+            res['jobs'] = jobs
+            res['jobs_per_s'] = jobs / res['median_s']
+            results[f'{name} x{jobs}'] = res
+    return results
+
+
+def compare(results, baseline):
+    """print median ratio against a previous run, > 1 is slower"""
+    def flatten(d, prefix=''):
+        for k, v in d.items():
+            if isinstance(v, dict) and 'median_s' in v:
+                yield prefix + k, v['median_s']
+            elif isinstance(v, dict):
+                yield from flatten(v, prefix + k + '.')
+    old = dict(flatten(baseline.get('results', {})))
+    for name, median in flatten(results['results']):
+        if name in old and old[name]:
+            print(f'{name:45} {median / old[name]:6.2f}x', file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    rom_group = parser.add_mutually_exclusive_group()
+    rom_group.add_argument('--rom', type=pathlib.Path, help='vanilla ROM for the generation benchmarks')
+    rom_group.add_argument('--synthetic', action='store_true',
+                           help='run generation against a synthetic ROM stand-in, output is not playable')
+    parser.add_argument('--repeat', type=int, default=10, help='runs per benchmark')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count() or 1, help='parallel jobs for throughput')
+    parser.add_argument('--output', type=pathlib.Path, help='write JSON results to file')
+    parser.add_argument('--baseline', type=pathlib.Path, help='JSON results of a previous run to compare against')
+    args = parser.parse_args()
+
+    import pyevermizer
+
+    results = {
+        'python': sys.version,
+        'implementation': platform.python_implementation(),
+        'machine': platform.machine(),
+        'system': platform.system(),
+        'pyevermizer': getattr(pyevermizer, '__file__', None),
+        'synthetic_rom': args.synthetic,
+        'results': {
+            'import': bench_import(args.repeat),
+            'getters': bench_getters(pyevermizer, args.repeat * 10),
+        },
+    }
+    if args.rom or args.synthetic:
+        rom = args.rom.read_bytes() if args.rom else synthrom.make_rom()
+        results['results']['generation'] = bench_generation(pyevermizer, rom, args.repeat, args.jobs)
+
+    text = json.dumps(results, indent=2)
+    if args.output:
+        args.output.write_text(text + '\n', encoding='utf-8')
+    print(text)
+    if args.baseline:
+        compare(results, json.loads(args.baseline.read_text(encoding='utf-8')))
+
+
+if __name__ == '__main__':
+    main()
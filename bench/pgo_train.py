@@ -0,0 +1,59 @@
+"""Training workload for the pgo build profile of setup.py.
+
+Loads the instrumented extension from the given path and runs the common entry points against the synthetic ROM of
+synthrom.py, so the profile covers argument conversion, memfiles, logging, patch output and the data getters.
+"""
+
+import importlib.machinery
+import importlib.util
+import os
+import pathlib
+import sys
+import tempfile
+
+bench_dir = pathlib.Path(__file__).parent.absolute()
+sys.path.insert(0, str(bench_dir))
+
+import synthrom  # noqa: E402
+
+SETTINGS = ('pgo', 'slot', 'r', 0, 0, [])  # apseed, apslot, flags, money, exp, switches
+GETTERS = ('get_locations', 'get_sniff_locations', 'get_items', 'get_sniff_items', 'get_extra_items',
+           'get_traps', 'get_logic')
+
+
+def load(path):
+    loader = importlib.machinery.ExtensionFileLoader('_evermizer', str(path))
+    spec = importlib.util.spec_from_file_location('_evermizer', str(path), loader=loader)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def train(evermizer, seeds):
+    rom = synthrom.make_rom()
+    handle = evermizer.load_rom(rom)
+    for name in GETTERS:
+        getattr(evermizer, name)()
+        getattr(evermizer, name)(copy=True)
+    apseed, apslot, flags, money, exp, switches = SETTINGS
+    for seed in range(seeds):
+        evermizer.generate(handle, [], apseed, apslot, seed, flags, money, exp, switches, log=[])
+    for fmt in ('ips', 'bps'):
+        evermizer.generate(handle, [], apseed, apslot, seeds, flags, money, exp, switches, format=fmt, log=[])
+    evermizer.generate_many([(handle, [], apseed, apslot, seed, flags, money, exp, switches) for seed in range(seeds)])
+    with tempfile.TemporaryDirectory() as tmp:
+        src = os.path.join(tmp, 'src.sfc')
+        with open(src, 'wb') as f:
+            f.write(rom)
+        evermizer.main(src, os.path.join(tmp, 'out.sfc'), [], apseed, apslot, seeds, flags, money, exp, switches)
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print(f'Usage: {sys.argv[0]} <path to _evermizer extension> [seeds]', file=sys.stderr)
+        sys.exit(1)
+    train(load(sys.argv[1]), int(sys.argv[2]) if len(sys.argv) > 2 else 16)
+
+
+if __name__ == '__main__':
+    main()
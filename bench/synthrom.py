@@ -0,0 +1,44 @@
+"""Synthetic stand-in for the vanilla ROM, for benchmarks and build profiling only.
+
+The image has the size, HiROM title and checksum that load_rom() and evermizer check, but its content is
+pseudo-random. The generated output is not a playable game and must not be used as one.
+"""
+
+import random
+
+ROM_SIZE = 0x300000
+SNES_HEADER = 0xFFC0
+TITLE = b'SECRET OF EVERMORE   '  # 21 bytes, space padded
+
+
+def checksum(rom: bytes) -> int:
+    """SNES checksum: sum of all bytes, remainder above the largest power of 2 is mirrored"""
+    base = 1
+    while base * 2 <= len(rom):
+        base *= 2
+    total = sum(rom[:base])
+    if len(rom) > base:
+        total += sum(rom[base:]) * (base // (len(rom) - base))
+    return total & 0xffff
+
+
+def make_rom(seed: int = 0, size: int = ROM_SIZE, headered: bool = False) -> bytes:
+    """Returns a synthetic ROM image. Same seed gives the same image"""
+    rng = random.Random(seed)
+    block = bytes(rng.getrandbits(8) for _ in range(0x10000))
+    rom = bytearray(block * (size // len(block)))
+    rom[SNES_HEADER:SNES_HEADER + len(TITLE)] = TITLE
+    # complement and checksum are part of the sum. 0xffff/0x0000 adds the same as any valid pair
+    rom[SNES_HEADER + 0x1c:SNES_HEADER + 0x20] = b'\xff\xff\x00\x00'
+    s = checksum(rom)
+    rom[SNES_HEADER + 0x1c:SNES_HEADER + 0x20] = bytes(((s ^ 0xffff) & 0xff, (s ^ 0xffff) >> 8, s & 0xff, s >> 8))
+    return (bytes(0x200) if headered else b'') + bytes(rom)
+
+
+if __name__ == '__main__':
+    import sys
+    if len(sys.argv) != 2:
+        print(f'Usage: {sys.argv[0]} <out.sfc>')
+        sys.exit(1)
+    with open(sys.argv[1], 'wb') as f:
+        f.write(make_rom())
@@ -1,9 +1,9 @@
-from setuptools import setup, Extension
-from setuptools.command.build_ext import build_ext
+import os
 import pathlib
 import subprocess
 import shutil
 import platform
+import sys
 
 root_dir = pathlib.Path(__file__).parent.absolute().relative_to(pathlib.Path.cwd().absolute())
 src_dir = root_dir / 'src'
@@ -12,10 +12,10 @@ evermizer_dir = src_dir / 'evermizer'
 sources = [src_dir / '_evermizer.c']
 scripts = list(evermizer_dir.glob('patches/*.txt'))
 ips = list(evermizer_dir.glob('ips/*.txt'))
-data = [evermizer_dir / 'gourds.csv']
+data = [evermizer_dir / 'gourds.csv', evermizer_dir / 'sniff.csv']  # read by prebuild()
 tools = [evermizer_dir / 'gourds2h.py', evermizer_dir / 'sniff2h.py',
          evermizer_dir / 'everscript2h.py', evermizer_dir / 'ips2h.py']
-includes = list(root_dir.glob('*.h')) + list(evermizer_dir.glob('*.h')) + [evermizer_dir / 'main.c']
+includes = list(src_dir.glob('*.h')) + list(evermizer_dir.glob('*.h')) + [evermizer_dir / 'main.c']
 generated = [evermizer_dir / 'gourds.h', evermizer_dir / 'sniff.h', evermizer_dir / 'gen.h']
 depends = [f for f in scripts + ips + data + includes + tools if f not in generated]
 
@@ -36,21 +36,43 @@ release_l_args = {
     'unix': ['-s', '-Wl,--gc-sections'],
     'gcc': ['-s', '-Wl,--gc-sections']
 }
-c_args = release_c_args
-l_args = release_l_args
+speed_c_args = {
+    'unix': ['-O3', '-flto', '-ffunction-sections'],
+    'gcc': ['-O3', '-flto', '-ffunction-sections'],
+    'msvc': ['/O2', '/GL'],
+    'mingw32': ['-O3', '-flto'],
+}
+speed_l_args = {
+    'unix': ['-O3', '-flto', '-s', '-Wl,--gc-sections'],
+    'gcc': ['-O3', '-flto', '-s', '-Wl,--gc-sections'],
+    'msvc': ['/LTCG'],
+    'mingw32': ['-O3', '-flto', '-s'],
+}
+pgo_compilers = ('unix', 'gcc', 'mingw32')  # speed + instrumentation, training run, speed + profile
+
+
+def get_build_profile():
+    """EVERMIZER_BUILD_PROFILE: size (default), speed or pgo. an invalid value warns and builds size"""
+    profile = os.environ.get('EVERMIZER_BUILD_PROFILE', 'size')
+    if profile not in ('size', 'speed', 'pgo'):
+        print(f'Invalid EVERMIZER_BUILD_PROFILE {profile}, expected size, speed or pgo. Using size profile',
+              file=sys.stderr)
+        return 'size'
+    if profile == 'pgo' and 'emscripten' in (sys.platform + os.environ.get('_PYTHON_HOST_PLATFORM', '')):
+        print('Can not run the pgo training for WASM, using speed profile')
+        return 'speed'
+    return profile
+
+
+build_profile = get_build_profile()
+c_args = release_c_args if build_profile == 'size' else speed_c_args
+l_args = release_l_args if build_profile == 'size' else speed_l_args
 
 if platform.system() == 'Darwin':
     for tool in l_args:  # gc-sections not supported by llvm
         if '-Wl,--gc-sections' in l_args[tool]:
             l_args[tool].remove('-Wl,--gc-sections')
 
-evermizer_module = Extension(
-    'pyevermizer._evermizer',
-    sources=list(map(str, sources)),
-    depends=list(map(str, depends)),
-    define_macros=[('NO_ASSERT', 1), ('NDEBUG', 1)])
-
-
 class EvermizerPreBuild:
     """Custom build mixin to run pre-build steps for evermizer"""
     @staticmethod
@@ -72,34 +94,101 @@ class EvermizerPreBuild:
                 raise
 
 
-class EvermizerExtBuilder(EvermizerPreBuild, build_ext):
+class EvermizerExtBuilder(EvermizerPreBuild):
+    """Custom build_ext mixin, combined with setuptools' build_ext in main()"""
     def run(self):
         self.prebuild()
-        return build_ext.run(self)
+        return super().run()
+
+    def set_args(self, extra_c_args=(), extra_l_args=()):
+        c = self.compiler.compiler_type
+        for e in self.extensions:
+            e.extra_compile_args = c_args.get(c, []) + list(extra_c_args)
+            e.extra_link_args = l_args.get(c, []) + list(extra_l_args)
+
+    def is_clang(self):
+        try:
+            res = subprocess.run([self.compiler.compiler_so[0], '--version'], stdout=subprocess.PIPE,
+                                 stderr=subprocess.STDOUT, check=True)
+            return b'clang' in res.stdout
+        except (OSError, subprocess.CalledProcessError, AttributeError, IndexError):
+            return platform.system() == 'Darwin'
+
+    def build_pgo(self):
+        """Build instrumented, generate seeds with the synthetic ROM, then build with the recorded profile"""
+        profile_dir = pathlib.Path(self.build_temp).absolute() / 'pgo'
+        shutil.rmtree(profile_dir, ignore_errors=True)
+        profile_dir.mkdir(parents=True)
+        clang = self.is_clang()
+        if clang:
+            generate = ['-fprofile-instr-generate=' + str(profile_dir / '%p.profraw')]
+        else:
+            generate = ['-fprofile-generate=' + str(profile_dir), '-fprofile-update=atomic']
+        self.force = True  # rebuild, even if up to date
+        self.set_args(generate, generate)
+        super().build_extensions()
+
+        print('Running pgo training...')
+        try:
+            for e in self.extensions:
+                subprocess.run([sys.executable, str(root_dir / 'bench' / 'pgo_train.py'),
+                                self.get_ext_fullpath(e.name)], check=True)
+            if clang:
+                profdata = profile_dir / 'merged.profdata'
+                llvm_profdata = shutil.which('llvm-profdata')
+                cmd = [llvm_profdata] if llvm_profdata else ['xcrun', 'llvm-profdata']
+                subprocess.run([*cmd, 'merge', '-o', str(profdata), *map(str, profile_dir.glob('*.profraw'))],
+                               check=True)
+                use = ['-fprofile-instr-use=' + str(profdata)]
+            else:
+                use = ['-fprofile-use=' + str(profile_dir), '-fprofile-correction', '-Wno-missing-profile']
+        except (OSError, subprocess.CalledProcessError) as ex:
+            # i.e. evermizer rejecting the synthetic ROM. the instrumented build must not be shipped
+            print(f'pgo training failed ({ex}), using speed profile')
+            use = []
+        self.set_args(use, use)
+        return super().build_extensions()
 
     def build_extensions(self):
         c = self.compiler.compiler_type
         if c not in c_args and c not in l_args:
             print('using unknown compiler: ' + c)
-        if c in c_args:
-            for e in self.extensions:
-                e.extra_compile_args = c_args[c]
-        if c in l_args:
-            for e in self.extensions:
-                e.extra_link_args = l_args[c]
-        return build_ext.build_extensions(self)
-
-
-setup(name='pyevermizer',
-      author='black-sliver',
-      version='0.50.1',
-      description='Python wrapper for Evermizer',
-      long_description=long_description,
-      long_description_content_type='text/markdown',
-      license='LGPLv3',
-      url='https://github.com/black-sliver/pyevermizer',
-      python_requires='>=3',  # TODO: test this
-      packages=['pyevermizer'],
-      package_dir={'pyevermizer': str(src_dir)},
-      ext_modules=[evermizer_module],
-      cmdclass={'build_ext': EvermizerExtBuilder})
+        if build_profile == 'pgo' and c in pgo_compilers:
+            return self.build_pgo()
+        if build_profile == 'pgo':
+            print('pgo not supported for ' + c + ', using speed profile')
+        self.set_args()
+        return super().build_extensions()
+
+
+def main():
+    # setuptools is only needed to build, importing this for the file lists stays fast
+    from setuptools import setup, Extension
+    from setuptools.command.build_ext import build_ext
+
+    class BuildExt(EvermizerExtBuilder, build_ext):
+        pass
+
+    evermizer_module = Extension(
+        'pyevermizer._evermizer',
+        sources=list(map(str, sources)),
+        depends=list(map(str, depends)),
+        define_macros=[('NO_ASSERT', 1), ('NDEBUG', 1)])
+
+    setup(name='pyevermizer',
+          author='black-sliver',
+          version='0.50.1',
+          description='Python wrapper for Evermizer',
+          long_description=long_description,
+          long_description_content_type='text/markdown',
+          license='LGPLv3',
+          url='https://github.com/black-sliver/pyevermizer',
+          python_requires='>=3.9',  # multi-phase init with module state
+          packages=['pyevermizer'],
+          package_dir={'pyevermizer': str(src_dir)},
+          ext_modules=[evermizer_module],
+          cmdclass={'build_ext': BuildExt})
+
+
+if __name__ == '__main__':
+    main()
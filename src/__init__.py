@@ -1 +1,34 @@
+import threading as _threading
+
 from ._evermizer import *
+
+_executor = None
+_executor_lock = _threading.Lock()
+
+
+def _default_executor():
+    """thread pool shared by generate_async, one worker per core"""
+    global _executor
+    import os
+    from concurrent.futures import ThreadPoolExecutor
+
+    with _executor_lock:
+        if _executor is None:
+            _executor = ThreadPoolExecutor(max_workers=os.cpu_count() or 1, thread_name_prefix='evermizer')
+        return _executor
+
+
+async def generate_async(*args, executor=None, **kwargs):
+    """generate() as coroutine. runs on executor or a shared pool with one worker per core, logs on the event loop's
+    thread. cancelling the task drops a queued job, but does not abort a running one: it keeps its worker until
+    evermizer returns and its output is discarded, see GenerateJob.cancel"""
+    import asyncio
+
+    loop = asyncio.get_running_loop()
+    job = GenerateJob(*args, **kwargs)
+    try:
+        await loop.run_in_executor(executor or _default_executor(), job.run)
+    except asyncio.CancelledError:
+        job.cancel()
+        raise
+    return job.result()
@@ -1,6 +1,19 @@
 #include <Python.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <errno.h>
+#include "stats.h"
+
+/* native allocations go through evermizer_malloc, so they can be accounted and traced */
+static void *evermizer_malloc(size_t size);
+static void *evermizer_realloc(void *ptr, size_t size);
+static void evermizer_free(void *ptr);
+#define MEMFILE_MALLOC evermizer_malloc
+#define MEMFILE_REALLOC evermizer_realloc
+#define MEMFILE_FREE evermizer_free
+#include "memfile.h"
+#include "patch.h"
 
 #if defined(__CLING__) /* hide evermizer definitions in cppyy */
 namespace _evermizer {
@@ -14,101 +27,578 @@ namespace _evermizer {
 #endif
 
 
-/* NOTE: overwriting printf makes it impossible to run multiple mains
-         concurrently without loading the module multiple times,
-         but luckily it's fast. */
-static PyObject *logger = NULL;
-static PyObject *semaphore = NULL;
-static char *stdoutbuf = NULL;
+#if defined(__cplusplus)
+#define THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+/* flag that is set by one thread and polled by another */
+#if defined(__cplusplus) || defined(_MSC_VER) || defined(__STDC_NO_ATOMICS__)
+typedef volatile long abort_flag_t;
+#define ABORT_FLAG_SET(p) (*(p) = 1)
+#define ABORT_FLAG_GET(p) (*(p) != 0)
+#else
+#include <stdatomic.h>
+typedef atomic_int abort_flag_t;
+#define ABORT_FLAG_SET(p) atomic_store(p, 1)
+#define ABORT_FLAG_GET(p) (atomic_load(p) != 0)
+#endif
+
+
+/* state of a single generation. evermizer's printf is redirected to the context
+   of the calling thread, so output and files of calls don't mix, see also evermizer_lock. */
+typedef struct {
+    PyObject *logger;
+    PyObject *log_list;  /* if set, log records are appended here instead of being logged */
+    bool log_stdout;     /* stdout is captured, level is enabled */
+    bool log_stderr;     /* stderr is captured, level is enabled */
+    memfile log;         /* captured records: level char, text, \n */
+    memfile stdout_line; /* incomplete line printed to stdout */
+    memfile files[4];    /* files evermizer can open by MEMFILE_PREFIX path */
+    size_t num_files;
+    const char *src_path; /* argv of source and output ROM, to detect phases */
+    const char *dst_path;
+    FILE *src_file;
+    FILE *dst_file;
+    run_stats stats;
+    PyObject *stats_dict; /* if set, filled with stats after the run */
+    abort_flag_t aborted; /* file access fails once set, see GenerateJob.cancel */
+} evermizer_context;
+
+static THREAD_LOCAL evermizer_context *current_context = NULL;
+
+/* evermizer's main.c is a whole program with file-scope tables and state that main may change, and it was not
+   audited for reentrancy. runs of main and reads of its tables are serialized by this process-wide lock.
+   allocated by the first exec and never freed */
+static PyThread_type_lock evermizer_lock = NULL;
+static THREAD_LOCAL int evermizer_lock_depth = 0; /* nested use on one thread, i.e. from a finalizer */
+
+static void
+evermizer_lock_enter(bool gil)
+{
+    if (evermizer_lock_depth++) return;
+    if (PyThread_acquire_lock(evermizer_lock, NOWAIT_LOCK)) return;
+    if (!gil) {
+        PyThread_acquire_lock(evermizer_lock, WAIT_LOCK);
+        return;
+    }
+    /* wait for a running main without blocking other threads */
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(evermizer_lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+}
+
+static void
+evermizer_lock_leave(void)
+{
+    if (!--evermizer_lock_depth) PyThread_release_lock(evermizer_lock);
+}
 #define STDOUT_LOGGER_LEVEL "debug"
 #define STDERR_LOGGER_LEVEL "error"
+#define STDOUT_LOG_LEVEL 10 /* logging.DEBUG */
+#define STDERR_LOG_LEVEL 40 /* logging.ERROR */
+#define STDOUT_RECORD 'D'
+#define STDERR_RECORD 'E'
+
+/* tracemalloc domain of large native blocks, see native_track and tracemalloc.DomainFilter */
+#define NATIVE_TRACEMALLOC_DOMAIN 0x534f45 /* "SoE" */
+/* blocks from this size on are traced. tracking takes the GIL, so small blocks are only accounted */
+#define NATIVE_TRACK_MIN_SIZE 0x10000
+
+/* size is stored in front of every block, so free() can account for it */
+typedef union {
+    struct {
+        size_t size;
+        bool tracked; /* known to tracemalloc */
+    } info;
+    long double align;
+    void *ptr;
+} native_header;
+
+static void
+native_account(int64_t delta)
+{
+    /* blocks are accounted to the run of the calling thread, if any */
+    evermizer_context *ctx = current_context;
+    if (!ctx) return;
+    ctx->stats.native_bytes += delta;
+    if (ctx->stats.native_bytes > ctx->stats.native_peak) ctx->stats.native_peak = ctx->stats.native_bytes;
+}
 
-static int evermizer_fprintf(FILE *f, const char *fmt, ...)
+static void
+native_track(native_header *h)
+{
+    /* large blocks, i.e. ROM and output buffers, are traced while they are alive. PyTraceMalloc_Track takes
+       the GIL itself, so this works on threads that released it, and the size limit keeps it to a few calls per run */
+    h->info.tracked = h->info.size >= NATIVE_TRACK_MIN_SIZE &&
+        PyTraceMalloc_Track(NATIVE_TRACEMALLOC_DOMAIN, (uintptr_t) (h + 1), h->info.size) == 0;
+}
+
+static void
+native_untrack(native_header *h)
+{
+    if (h->info.tracked) PyTraceMalloc_Untrack(NATIVE_TRACEMALLOC_DOMAIN, (uintptr_t) (h + 1));
+    h->info.tracked = false;
+}
+
+static void *
+evermizer_malloc(size_t size)
+{
+    native_header *h;
+    if (size > SIZE_MAX - sizeof(*h)) return NULL;
+    h = (native_header*) malloc(sizeof(*h) + size);
+    if (!h) return NULL;
+    h->info.size = size;
+    native_account((int64_t) size);
+    native_track(h);
+    return h + 1;
+}
+
+static void *
+evermizer_calloc(size_t n, size_t size)
+{
+    void *p;
+    if (size && n > SIZE_MAX / size) return NULL;
+    p = evermizer_malloc(n * size);
+    if (p) memset(p, 0, n * size);
+    return p;
+}
+
+static void
+evermizer_free(void *ptr)
+{
+    native_header *h;
+    if (!ptr) return;
+    h = (native_header*) ptr - 1;
+    native_untrack(h);
+    native_account(-(int64_t) h->info.size);
+    free(h);
+}
+
+static void *
+evermizer_realloc(void *ptr, size_t size)
+{
+    native_header *h, *old;
+    size_t old_size;
+    if (!ptr) return evermizer_malloc(size);
+    if (size > SIZE_MAX - sizeof(*h)) return NULL;
+    old = (native_header*) ptr - 1;
+    old_size = old->info.size;
+    native_untrack(old); /* the block may move */
+    h = (native_header*) realloc(old, sizeof(*h) + size);
+    if (!h) {
+        native_track(old);
+        return NULL;
+    }
+    h->info.size = size;
+    native_account((int64_t) size - (int64_t) old_size);
+    native_track(h);
+    return h + 1;
+}
+
+static char *
+evermizer_strdup(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *p = (char*) evermizer_malloc(len);
+    if (p) memcpy(p, s, len);
+    return p;
+}
+
+static char *
+evermizer_strndup(const char *s, size_t n)
+{
+    size_t len = 0;
+    char *p;
+    while (len < n && s[len]) len++;
+    p = (char*) evermizer_malloc(len + 1);
+    if (!p) return NULL;
+    memcpy(p, s, len);
+    p[len] = 0;
+    return p;
+}
+
+static memfile *
+context_memfile(FILE *f)
+{
+    /* memfiles are handed to evermizer as FILE*, see evermizer_fopen */
+    evermizer_context *ctx = current_context;
+    if (!ctx || !f) return NULL;
+    for (size_t i = 0; i < ctx->num_files; i++) {
+        if ((FILE*) &ctx->files[i] == f) return &ctx->files[i];
+    }
+    return NULL;
+}
+
+static bool
+context_aborted(void)
+{
+    /* evermizer can only be stopped by failing its next file access */
+    evermizer_context *ctx = current_context;
+    return ctx && ABORT_FLAG_GET(&ctx->aborted);
+}
+
+static int
+vfprintf_memfile(memfile *mf, const char *fmt, va_list args)
 {
-    int res;
     char buf[1024];
     char *heap = NULL;
-    va_list args;
-    va_start(args, fmt);
-    if (logger && (f == stdout || f == stderr)) {
-        const char *level = (f==stdout) ? STDOUT_LOGGER_LEVEL : STDERR_LOGGER_LEVEL;
-        /* try to print to buffer on stack */
-        res = vsnprintf(buf, sizeof(buf), fmt, args);
-        if (res > 0 && (size_t)res < sizeof(buf)) {
-            /* buf valid */
-            if (f == stdout) {
-                size_t buflen = strlen(buf);
-                size_t oldlen = stdoutbuf ? strlen(stdoutbuf) : 0;
-                if (!oldlen && buf[buflen-1] == '\n') {
-                    /* immediately print stdout if buf is empty and chunk ends in \n. optimized most-common case */
-                    buf[buflen-1] = 0;
-                    Py_XDECREF(PyObject_CallMethod(logger, level, "(s)", buf));
-                } else {
-                    /* append to stdoutbuf, see below for printing it */
-                    stdoutbuf = (char*)realloc(stdoutbuf, buflen + oldlen + 1);
-                    if (!stdoutbuf) {
-                        res = -1;
-                        goto cleanup;
-                    }
-                    memcpy(stdoutbuf+oldlen, buf, buflen+1);
-                }
-            } else {
-                /* immediately print stderr chunk */
-                Py_XDECREF(PyObject_CallMethod(logger, level, "(s)", buf));
+    va_list copy;
+    int res;
+    va_copy(copy, args);
+    res = vsnprintf(buf, sizeof(buf), fmt, args);
+    if (res >= (int) sizeof(buf)) {
+        heap = (char*) evermizer_malloc((size_t)res + 1);
+        res = heap ? vsnprintf(heap, (size_t)res + 1, fmt, copy) : -1;
+    }
+    va_end(copy);
+    if (res > 0 && memfile_write(mf, heap ? heap : buf, 1, (size_t)res) != (size_t)res) res = -1;
+    evermizer_free(heap);
+    return res;
+}
+
+static void
+context_add_record(evermizer_context *ctx, char level, const char *text, size_t len)
+{
+    /* lines are counted for stats, also if the level is not logged */
+    if (len && text[len-1] == '\n') len--;
+    ctx->stats.stdout_lines++;
+    if (!ctx->log_stdout) return;
+    memfile_write(&ctx->log, &level, 1, 1);
+    memfile_write(&ctx->log, text, 1, len);
+    memfile_write(&ctx->log, "\n", 1, 1);
+}
+
+static void
+context_flush_stdout(evermizer_context *ctx, size_t scan_from, bool all)
+{
+    /* move complete lines from stdout_line to log, keep the incomplete rest */
+    memfile *line = &ctx->stdout_line;
+    size_t start = 0;
+    const char *nl;
+    if (!line->size) return;
+    while ((nl = (const char*) memchr(line->data + scan_from, '\n', line->size - scan_from)) != NULL) {
+        size_t end = (size_t)(nl - (const char*) line->data) + 1;
+        context_add_record(ctx, STDOUT_RECORD, (const char*) line->data + start, end - start);
+        start = scan_from = end;
+    }
+    if (all && start < line->size) {
+        context_add_record(ctx, STDOUT_RECORD, (const char*) line->data + start, line->size - start);
+        start = line->size;
+    }
+    if (start) {
+        memmove(line->data, line->data + start, line->size - start);
+        line->size -= start;
+        line->pos = line->size;
+    }
+}
+
+static int
+context_level_enabled(evermizer_context *ctx, int level)
+{
+    PyObject *res = PyObject_CallMethod(ctx->logger, "isEnabledFor", "(i)", level);
+    int enabled;
+    if (!res) return -1;
+    enabled = PyObject_IsTrue(res);
+    Py_DECREF(res);
+    return enabled;
+}
+
+static int
+context_init_log(evermizer_context *ctx)
+{
+    /* check once per run which levels will be captured */
+    int enabled;
+    memfile_init_write(&ctx->log, NULL, NULL, 0);
+    memfile_init_write(&ctx->stdout_line, NULL, NULL, 0);
+    if (ctx->log_list) {
+        ctx->log_stdout = ctx->log_stderr = true;
+        return 0;
+    }
+    enabled = context_level_enabled(ctx, STDOUT_LOG_LEVEL);
+    if (enabled < 0) return -1;
+    ctx->log_stdout = enabled;
+    enabled = context_level_enabled(ctx, STDERR_LOG_LEVEL);
+    if (enabled < 0) return -1;
+    ctx->log_stderr = enabled;
+    return 0;
+}
+
+static void
+context_emit_log(evermizer_context *ctx)
+{
+    /* called with the GIL after the run. consecutive records of the same level
+       are sent to the logger as one record, or added to log_list one by one */
+    const char *p, *end;
+    context_flush_stdout(ctx, 0, true);
+    p = (const char*) ctx->log.data;
+    end = ctx->log.error ? p : p + ctx->log.size; /* out of memory while capturing */
+    while (p < end) {
+        char level = *p;
+        const char *text = p + 1;
+        const char *next;
+        PyObject *msg;
+        if (ctx->log_list) {
+            next = (const char*) memchr(text, '\n', (size_t)(end - text)) + 1;
+            msg = Py_BuildValue("(iN)", level == STDOUT_RECORD ? STDOUT_LOG_LEVEL : STDERR_LOG_LEVEL,
+                                PyUnicode_DecodeUTF8(text, next - text - 1, "replace"));
+            if (msg) PyList_Append(ctx->log_list, msg);
+        } else {
+            /* strip level chars in place to get one text for the batch */
+            char *w = (char*) text;
+            next = text;
+            for (;;) {
+                const char *nl = (const char*) memchr(next, '\n', (size_t)(end - next));
+                memmove(w, next, (size_t)(nl - next));
+                w += nl - next;
+                next = nl + 1;
+                if (next >= end || *next != level) break;
+                *w++ = '\n';
+                next++;
             }
-        } else if (res > 0) {
-            /* allocate bigger buffer on heap */
-            heap = (char*)malloc((size_t)res+1);
-            if (heap) {
-                va_end(args);
-                va_start(args, fmt);
-                res = vsnprintf(heap, (size_t)res+1, fmt, args);
-                if (res > 0) {
-                    /* heap valid */
-                    if (f == stdout) {
-                        if (!stdoutbuf) {
-                            /* replace stdoutbuf by new chunk, see below for printing it */
-                            stdoutbuf = heap;
-                            heap = NULL;
-                        } else {
-                            /* append new chunk to stdoutbuf, see below for printing it */
-                            size_t oldlen = strlen(stdoutbuf);
-                            size_t heaplen = strlen(heap);
-                            stdoutbuf = (char*)realloc(stdoutbuf, oldlen + heaplen + 1);
-                            if (!stdoutbuf) {
-                                res = -1;
-                                goto cleanup;
-                            }
-                            memcpy(stdoutbuf + oldlen, heap, heaplen + 1);
-                        }
-                    } else {
-                        /* immediately print stderr chunk */
-                        Py_XDECREF(PyObject_CallMethod(logger, level, "(s)", heap));
-                    }
-                }
+            msg = PyUnicode_DecodeUTF8(text, w - text, "replace");
+            if (msg) {
+                Py_XDECREF(PyObject_CallMethod(ctx->logger, level == STDOUT_RECORD ? STDOUT_LOGGER_LEVEL
+                                                                                   : STDERR_LOGGER_LEVEL,
+                                               "(O)", msg));
             }
         }
-        if (f == stdout && stdoutbuf && *stdoutbuf) {
-            /* print stdoutbuf if it ends in newline */
-            size_t newlen = strlen(stdoutbuf);
-            if (stdoutbuf[newlen-1] == '\n') {
-                stdoutbuf[newlen-1] = 0;
-                Py_XDECREF(PyObject_CallMethod(logger, level, "(s)", stdoutbuf));
-                free(stdoutbuf);
-                stdoutbuf = NULL;
+        Py_XDECREF(msg);
+        if (PyErr_Occurred()) PyErr_Clear(); /* ignore errors for bad printf */
+        p = next;
+    }
+    memfile_free(&ctx->log);
+    memfile_free(&ctx->stdout_line);
+}
+
+static void
+context_count_write(FILE *f, size_t n)
+{
+    evermizer_context *ctx = current_context;
+    if (ctx && f && f == ctx->dst_file) ctx->stats.bytes_written += n;
+}
+
+static FILE *
+context_opened(FILE *f, const char *path)
+{
+    /* phase changes when source and output ROM are opened */
+    evermizer_context *ctx = current_context;
+    if (!ctx || !f) return f;
+    if (ctx->src_path && strcmp(path, ctx->src_path) == 0) {
+        ctx->src_file = f;
+        if (ctx->stats.phase < PHASE_LOAD) stats_begin(&ctx->stats, PHASE_LOAD);
+    } else if (ctx->dst_path && strcmp(path, ctx->dst_path) == 0) {
+        ctx->dst_file = f;
+        if (ctx->stats.phase < PHASE_WRITE) stats_begin(&ctx->stats, PHASE_WRITE);
+    }
+    return f;
+}
+
+static void
+context_closing(FILE *f)
+{
+    evermizer_context *ctx = current_context;
+    if (!ctx || !f) return;
+    if (f == ctx->src_file) {
+        ctx->src_file = NULL;
+        if (ctx->stats.phase == PHASE_LOAD) stats_begin(&ctx->stats, PHASE_GENERATE);
+    } else if (f == ctx->dst_file) {
+        ctx->dst_file = NULL;
+        if (ctx->stats.phase == PHASE_WRITE) stats_begin(&ctx->stats, PHASE_FINISH);
+    }
+}
+
+static int evermizer_fprintf(FILE *f, const char *fmt, ...)
+{
+    int res = 0;
+    evermizer_context *ctx = current_context;
+    memfile *mf;
+    va_list args;
+    va_start(args, fmt);
+    if (ctx && f == stdout) {
+        /* collect stdout into lines, they are only kept if they would be logged */
+        size_t old_size = ctx->stdout_line.size;
+        res = vfprintf_memfile(&ctx->stdout_line, fmt, args);
+        if (res > 0) context_flush_stdout(ctx, old_size, false);
+    }
+    else if (ctx && f == stderr) {
+        /* every stderr chunk is a record */
+        if (!ctx->log_stderr) {
+            res = vsnprintf(NULL, 0, fmt, args);
+            if (res > 0) ctx->stats.stderr_lines++;
+        } else {
+            /* format straight into the log */
+            size_t start = ctx->log.size;
+            char level = STDERR_RECORD;
+            memfile_write(&ctx->log, &level, 1, 1);
+            res = vfprintf_memfile(&ctx->log, fmt, args);
+            if (res > 0) {
+                ctx->stats.stderr_lines++;
+                if (ctx->log.data[ctx->log.size-1] == '\n') ctx->log.size--;
+                ctx->log.pos = ctx->log.size;
+                memfile_write(&ctx->log, "\n", 1, 1);
+            } else {
+                ctx->log.size = ctx->log.pos = start;
             }
         }
     }
+    else if ((mf = context_memfile(f)) != NULL) {
+        res = vfprintf_memfile(mf, fmt, args);
+    }
     else {
         res = vfprintf(f, fmt, args);
     }
-cleanup:
-    free(heap);
     va_end(args);
-    if (PyErr_Occurred()) PyErr_Clear(); /* ignore errors for bad printf */
+    if (res > 0) context_count_write(f, (size_t) res);
+    return res;
+}
+
+static FILE *
+evermizer_fopen(const char *path, const char *mode)
+{
+    evermizer_context *ctx = current_context;
+    memfile *mf = NULL;
+    if (context_aborted()) {
+        errno = ECANCELED;
+        return NULL;
+    }
+    if (!ctx || strncmp(path, MEMFILE_PREFIX, sizeof(MEMFILE_PREFIX) - 1) != 0)
+        return context_opened(fopen(path, mode), path);
+    for (size_t i = 0; i < ctx->num_files; i++) {
+        if (ctx->files[i].name && strcmp(ctx->files[i].name, path) == 0) {
+            mf = &ctx->files[i];
+            break;
+        }
+    }
+    if (!mf && (strchr(mode, 'w') || strchr(mode, 'a')) && ctx->num_files < sizeof(ctx->files)/sizeof(*ctx->files)) {
+        /* unknown output file, i.e. a spoiler log. collect it and throw it away */
+        mf = &ctx->files[ctx->num_files++];
+        memfile_init_write(mf, NULL, NULL, 0);
+    }
+    if (!mf || mf->is_open || (mf->rdata && (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+')))) {
+        errno = mf ? EACCES : ENOENT;
+        return NULL;
+    }
+    mf->is_open = true;
+    mf->eof = mf->error = false;
+    mf->pos = 0;
+    if (strchr(mode, 'w')) memfile_truncate(mf);
+    if (strchr(mode, 'a')) mf->pos = mf->size;
+    return context_opened((FILE*) mf, path);
+}
+
+static int
+evermizer_fclose(FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    context_closing(f);
+    if (!mf) return fclose(f);
+    mf->is_open = false;
+    return mf->error ? EOF : 0;
+}
+
+static size_t
+evermizer_fread(void *ptr, size_t size, size_t nmemb, FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    size_t res;
+    if (context_aborted()) return 0;
+    res = mf ? memfile_read(mf, ptr, size, nmemb) : fread(ptr, size, nmemb, f);
+    if (current_context && f == current_context->src_file) current_context->stats.bytes_read += res * size;
+    return res;
+}
+
+static size_t
+evermizer_fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    size_t res;
+    if (context_aborted()) return 0;
+    res = mf ? memfile_write(mf, ptr, size, nmemb) : fwrite(ptr, size, nmemb, f);
+    context_count_write(f, res * size);
+    return res;
+}
+
+static int
+evermizer_fseek(FILE *f, long offset, int whence)
+{
+    memfile *mf = context_memfile(f);
+    return mf ? memfile_seek(mf, offset, whence) : fseek(f, offset, whence);
+}
+
+static long
+evermizer_ftell(FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    return mf ? (long) mf->pos : ftell(f);
+}
+
+static void
+evermizer_rewind(FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    if (mf) memfile_seek(mf, 0, SEEK_SET);
+    else rewind(f);
+}
+
+static char *
+evermizer_fgets(char *s, int n, FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    if (context_aborted()) return NULL;
+    return mf ? memfile_gets(mf, s, n) : fgets(s, n, f);
+}
+
+static int
+evermizer_fgetc(FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    if (context_aborted()) return EOF;
+    return mf ? memfile_getc(mf) : fgetc(f);
+}
+
+static int
+evermizer_fputs(const char *s, FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    int res = mf ? (memfile_write(mf, s, 1, strlen(s)) == strlen(s) ? 0 : EOF) : fputs(s, f);
+    if (res != EOF) context_count_write(f, strlen(s));
+    return res;
+}
+
+static int
+evermizer_fputc(int c, FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    unsigned char ch = (unsigned char) c;
+    int res = mf ? (memfile_write(mf, &ch, 1, 1) == 1 ? ch : EOF) : fputc(c, f);
+    if (res != EOF) context_count_write(f, 1);
     return res;
 }
 
+static int
+evermizer_feof(FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    return mf ? mf->eof : feof(f);
+}
+
+static int
+evermizer_ferror(FILE *f)
+{
+    memfile *mf = context_memfile(f);
+    return mf ? mf->error : ferror(f);
+}
+
+static int
+evermizer_fflush(FILE *f)
+{
+    return context_memfile(f) ? 0 : fflush(f);
+}
+
 
 #define NO_UI
 #define WITH_MULTIWORLD /* force on for wasm support */
@@ -117,9 +607,71 @@ cleanup:
 #define main evermizer_main
 #define printf(...) fprintf(stdout, __VA_ARGS__)
 #define fprintf evermizer_fprintf
+/* redirect file access for memfile support */
+#undef getc
+#undef feof
+#undef ferror
+#define fopen evermizer_fopen
+#define fclose evermizer_fclose
+#define fread evermizer_fread
+#define fwrite evermizer_fwrite
+#define fseek evermizer_fseek
+#define ftell evermizer_ftell
+#define rewind evermizer_rewind
+#define fgets evermizer_fgets
+#define fgetc evermizer_fgetc
+#define getc evermizer_fgetc
+#define fputs evermizer_fputs
+#define fputc evermizer_fputc
+#define feof evermizer_feof
+#define ferror evermizer_ferror
+#define fflush evermizer_fflush
+/* account allocations. blocks have a size header, so evermizer_free must never see a pointer from any other
+   allocator: libc functions that return memory to be freed by the caller are either redirected or fail to compile */
+#define malloc evermizer_malloc
+#define calloc evermizer_calloc
+#define realloc evermizer_realloc
+#define free evermizer_free
+#define strdup evermizer_strdup
+#define strndup evermizer_strndup
+#define getline(...) evermizer_unredirected_allocation
+#define getdelim(...) evermizer_unredirected_allocation
+#define asprintf(...) evermizer_unredirected_allocation
+#define vasprintf(...) evermizer_unredirected_allocation
+#define realpath(...) evermizer_unredirected_allocation
+#define open_memstream(...) evermizer_unredirected_allocation
+#define tempnam(...) evermizer_unredirected_allocation
 #include "evermizer/main.c"
 #undef printf
 #undef fprintf
+#undef fopen
+#undef fclose
+#undef fread
+#undef fwrite
+#undef fseek
+#undef ftell
+#undef rewind
+#undef fgets
+#undef fgetc
+#undef getc
+#undef fputs
+#undef fputc
+#undef feof
+#undef ferror
+#undef fflush
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#undef strdup
+#undef strndup
+#undef getline
+#undef getdelim
+#undef asprintf
+#undef vasprintf
+#undef realpath
+#undef open_memstream
+#undef tempnam
 #undef main
 
 #if defined(__CLING__) /* see above */
@@ -128,8 +680,54 @@ using namespace _evermizer;
 #endif
 
 /* types */
+#include "progression.h"
 #include "location.h"
 #include "item.h"
+#include "romhandle.h"
+#include "column.h"
+#include "lookup.h"
+#include "sweep.h"
+#include "packed.h"
+
+/* memoized getter results */
+enum cached_getter {
+    GET_LOCATIONS,
+    GET_SNIFF_LOCATIONS,
+    GET_ITEMS,
+    GET_SNIFF_ITEMS,
+    GET_EXTRA_ITEMS,
+    GET_TRAPS,
+    GET_LOGIC,
+    CACHED_GETTER_COUNT
+};
+
+/* per-interpreter module state */
+typedef struct {
+    PyObject *LocationType;
+    PyObject *ItemType;
+    PyObject *RomHandleType;
+    PyObject *ColumnType;
+    PyObject *ProgressionStateType;
+    PyObject *ReachabilityType;
+    PyObject *PackedType;
+    PyObject *GenerateJobType;
+    PyObject *cache[CACHED_GETTER_COUNT]; /* tuples of frozen objects */
+    PyThread_type_lock cache_lock;
+    pos_index location_pos; /* (type, index) -> position in get_locations() or get_sniff_locations() */
+    pos_index item_pos;     /* (type, index) -> position in get_items(), get_extra_items() or get_traps() */
+    name_index location_names;
+    logic_graph logic;
+} module_state;
+
+static inline module_state *
+get_module_state(PyObject *module)
+{
+    return (module_state *) PyModule_GetState(module);
+}
+
+/* types that need module state */
+#include "progressionstate.h"
+#include "reachability.h"
 
 /* helpers */
 static int
@@ -165,194 +763,1009 @@ path2ansi(PyObject *stringOrPath, void* result)
 
 static const char hexchars[] = "0123456789ABCDEF";
 
-/* methods */
-static PyObject *
-_evermizer_main(PyObject *self, PyObject *py_args)
-{
-    /* _evermizer.main call signature:
-        src: Path, dst: Path, placement: Path, apseed: str, apslot: str, seed: int, flags: str, money: int, exp: int, switches: list[str]
-    */
-
-    /* original main signature:
-          int argc, char** argv: { <exe> [flags ...] <src.sfc> [settings [seed]] }
-       mapped main signature:
-          15, { "evermizer", '-b", "-o", "<dst.sfc>", "--money", "<money%>", "--exp', "<exp%>",
-               "--id", "<hex(32B ap seed)>[:]<hex(32B ap slot)>", "--placement", "<placement.txt>",
-               [switches...,]
-               "<src.sfc>", "<flags>", "<seed>" }
-       TODO: split UI/argument parsing from generation in evermizer, so we don't need to call the C main
-    */
+#define MEMFILE_SRC MEMFILE_PREFIX "src.sfc"
+#define MEMFILE_DST MEMFILE_PREFIX "dst.sfc"
+#define MEMFILE_PLACEMENT MEMFILE_PREFIX "placement.txt"
+#define ROM_SIZE_HINT 0x400000 /* initial output buffer size */
 
-    PyObject *pyres = NULL;
-    PyObject *osrc, *odst, *oplacement;
-    const char *ap_seed, *ap_slot;
-    PyObject *oseed; /* any integer -> PyObject */
-    PyObject *switches;
-    const char* flags;
-    uint64_t seed;
-    int money, exp;
-    const char *src;
-    const char *dst;
-    const char *placement;
-    char sseed[21];
-    char sexp[5];
-    char smoney[5];
-    char id_buf[130]; /* hex(32B):hex(32B)\0 */
-    char *id_bufp = id_buf;
-    PyObject *logging;
+typedef struct {
+    PyObject *path; /* placement file as ansi bytes, or */
+    char *text;     /* placement rendered from python data */
+    size_t len;
+} placement_arg;
 
-    if (!PyArg_ParseTuple(py_args, "O&O&O&ssOsiiO", path2ansi, &osrc, path2ansi, &odst, path2ansi, &oplacement,
-                          &ap_seed, &ap_slot, &oseed, &flags, &money, &exp, &switches)) {
-        goto error;
+static bool
+is_valid_placement(long loc_type, long loc_index, long item_type, long item_index)
+{
+    /* validate against the tables that get_*locations and get_*items return */
+    if (loc_index < 0 || item_index < 0) return false;
+    switch (loc_type) {
+        case CHECK_GOURD: if ((size_t)loc_index >= ARRAY_SIZE(gourd_data)) return false; break;
+        case CHECK_BOSS: if ((size_t)loc_index >= ARRAY_SIZE(boss_names)) return false; break;
+        case CHECK_ALCHEMY: if ((size_t)loc_index >= ARRAY_SIZE(alchemy_locations)) return false; break;
+        case CHECK_SNIFF: if ((size_t)loc_index >= ARRAY_SIZE(sniff_data)) return false; break;
+        default: return false;
     }
-
-    seed = (uint64_t)PyLong_AsUnsignedLongLong(oseed);
-    if (PyErr_Occurred()) {
-        PyErr_Clear();
-        pyres = PyErr_Format(PyExc_TypeError, "6th parameter 'seed' must be unsigned integer type, but got %s",
-                            Py_TYPE(oseed)->tp_name);
-        goto cleanup;
+    switch (item_type) {
+        case CHECK_NONE: return item_index <= 0xffff; /* remote item */
+        case CHECK_GOURD: return (size_t)item_index < ARRAY_SIZE(gourd_drops_data);
+        case CHECK_BOSS: return (size_t)item_index < ARRAY_SIZE(boss_drop_names);
+        case CHECK_ALCHEMY: return (size_t)item_index < ARRAY_SIZE(alchemy_locations);
+        case CHECK_SNIFF: return item_index <= 0x3ff;
+        case CHECK_EXTRA: return (size_t)item_index < ARRAY_SIZE(extra_data);
+        case CHECK_TRAP: return (size_t)item_index < ARRAY_SIZE(trap_data);
+        default: return false;
     }
+}
 
-    src = PyBytes_AS_STRING(osrc);
-    dst = PyBytes_AS_STRING(odst);
-    placement = PyBytes_AS_STRING(oplacement);
-
-    snprintf(sseed, sizeof(sseed), "%" PRIx64, seed);
-
-    if (exp > 9999) exp = 9999;
-    if (exp < 0) exp = 0;
-    snprintf(sexp, sizeof(sexp), "%d", exp);
-
-    if (money > 9999) money = 9999;
-    if (money < 0) money = 0;
-    snprintf(smoney, sizeof(smoney), "%d", money);
-
-    memset(id_buf, 0, 130);
-    for (uint8_t i=0; i<32; i++) {
-        if (!ap_seed[i]) break;
-        *id_bufp++ = hexchars[((uint8_t)ap_seed[i]>>4)&0x0f];
-        *id_bufp++ = hexchars[((uint8_t)ap_seed[i]>>0)&0x0f];
-    }
-    *id_bufp++ = ':';
-    for (uint8_t i=0; i<32; i++) {
-        if (!ap_slot[i]) break;
-        *id_bufp++ = hexchars[((uint8_t)ap_slot[i]>>4)&0x0f];
-        *id_bufp++ = hexchars[((uint8_t)ap_slot[i]>>0)&0x0f];
+static int
+placement_append(placement_arg *out, long loc_type, long loc_index, long item_type, long item_index)
+{
+    /* render one line of placement.txt: "<loc type>,<loc index>:<item type>,<item index>\n" */
+    if (!is_valid_placement(loc_type, loc_index, item_type, item_index)) {
+        PyErr_Format(PyExc_ValueError, "Invalid placement (%ld, %ld, %ld, %ld)",
+                     loc_type, loc_index, item_type, item_index);
+        return 0;
     }
+    out->len += (size_t) sprintf(out->text + out->len, "%ld,%ld:%ld,%ld\n",
+                                 loc_type, loc_index, item_type, item_index);
+    return 1;
+}
 
-    /* if multithreading is enabled, wait for the previous thread to finish
-       before touching any globals */
-    if (semaphore) {
-        PyObject *lock = PyObject_CallMethod(semaphore, "acquire", NULL);
-        if (!lock) goto cleanup; // exception
-        Py_DECREF(lock);
-    }
+static void
+placement_arg_free(placement_arg *arg)
+{
+    Py_CLEAR(arg->path);
+    PyMem_RawFree(arg->text);
+    arg->text = NULL;
+}
 
-    /* setup printf redirection */
-    assert(!logger);
-    logging = PyImport_AddModule("logging");
-    if (!logging) goto release_lock;
-    logger = PyObject_CallMethod(logging, "getLogger", "(s)", "SoE");
-    if (!logger) goto release_lock;
-
-    do {
-        Py_ssize_t switches_len = PyList_Size(switches);
-        size_t argc = 15 + switches_len;
-        const char *argv[25] = {
-            "main", "-b", "-o", dst, "--money", smoney, "--exp", sexp,
-            "--id", id_buf, "--placement", placement
-        };
-        if (switches_len < 0 || argc >= ARRAY_SIZE(argv)) {
-            PyErr_SetString(PyExc_RuntimeError, "Too many switches to main!");
-            break;
+static int
+placement_from_pyobject(PyObject *o, void *result)
+{
+    /* placement can be a path to placement.txt, a sequence of
+       (loc_type, loc_index, item_type, item_index) or a buffer of packed uint16 records of the same */
+    placement_arg *out = (placement_arg *) result;
+    #define PLACEMENT_LINE_MAX 28 /* 4 * 5 digits + 3 separators + \n + \0 */
+    memset(out, 0, sizeof(*out));
+    if (PyBytes_Check(o) || PyUnicode_Check(o) || PyObject_HasAttrString(o, "__fspath__")) {
+        return path2ansi(o, &out->path);
+    }
+    if (PyObject_CheckBuffer(o)) {
+        Py_buffer view;
+        const char *records;
+        const char *fmt;
+        size_t n;
+        if (PyObject_GetBuffer(o, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) return 0;
+        /* native uint16 records or their raw bytes, not just anything of the same size */
+        fmt = view.format ? view.format : "B";
+        if (*fmt == '@' || *fmt == '=') fmt++;
+        if (strcmp(fmt, "B") != 0 && strcmp(fmt, "H") != 0) {
+            PyErr_Format(PyExc_TypeError, "Placement buffer must have format 'H' or 'B', not '%s'", view.format);
+            PyBuffer_Release(&view);
+            return 0;
         }
-        for (Py_ssize_t i=0; i<switches_len; i++) {
-            PyObject* sw = PyList_GetItem(switches, i);
-            argv[12+i] = PyUnicode_AsUTF8(sw);
+        if (view.len % (4 * sizeof(uint16_t))) {
+            PyBuffer_Release(&view);
+            PyErr_SetString(PyExc_ValueError, "Placement buffer size is not a multiple of the record size");
+            return 0;
         }
-        argv[argc-3] = src;
-        argv[argc-2] = flags;
-        argv[argc-1] = sseed;
-
-        /* TODO: verify ap_seed is <= 32 bytes */
-
-        int res = evermizer_main((int)argc, argv);
-        pyres = PyLong_FromLong(res);
-    } while (false);
-
-    /* flush and free stdout redirection buffer */
-    if (!PyErr_Occurred() && stdoutbuf && *stdoutbuf) {
-        Py_XDECREF(PyObject_CallMethod(logger, STDOUT_LOGGER_LEVEL, "(s)", stdoutbuf));
-        if (PyErr_Occurred()) PyErr_Clear(); // ignore errors for bad printf
-    }
-    free(stdoutbuf);
-    stdoutbuf = NULL;
-
-    /* cleanup */
-    Py_DECREF(logger);
-    logger = NULL;
-
-release_lock:
-    if (semaphore) {
-        PyObject *release = PyObject_CallMethod(semaphore, "release", NULL);
-        if (!release) {
-            Py_DECREF(pyres);
-            pyres = NULL; // exception
-            goto cleanup;
+        records = (const char *) view.buf;
+        n = (size_t) view.len / (4 * sizeof(uint16_t));
+        out->text = (char*) PyMem_RawMalloc(n * PLACEMENT_LINE_MAX + 1);
+        if (!out->text) {
+            PyBuffer_Release(&view);
+            PyErr_NoMemory();
+            return 0;
+        }
+        out->text[0] = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint16_t r[4]; /* the buffer may be unaligned, i.e. a slice */
+            memcpy(r, records + sizeof(r) * i, sizeof(r));
+            if (!placement_append(out, r[0], r[1], r[2], r[3])) {
+                PyBuffer_Release(&view);
+                placement_arg_free(out);
+                return 0;
+            }
+        }
+        PyBuffer_Release(&view);
+        return 1;
+    } else {
+        /* private copy, safe against concurrent modification without the GIL */
+        PyObject *seq = PySequence_Check(o) ? PySequence_Tuple(o) : NULL;
+        Py_ssize_t n;
+        if (!seq) {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_TypeError, "placement must be a path, sequence of tuples or buffer");
+            return 0;
+        }
+        n = PyTuple_GET_SIZE(seq);
+        out->text = (char*) PyMem_RawMalloc((size_t) n * PLACEMENT_LINE_MAX + 1);
+        if (!out->text) {
+            Py_DECREF(seq);
+            PyErr_NoMemory();
+            return 0;
+        }
+        out->text[0] = 0;
+        for (Py_ssize_t i = 0; i < n; i++) {
+            long loc_type, loc_index, item_type, item_index;
+            if (!PyArg_ParseTuple(PyTuple_GET_ITEM(seq, i), "llll;placement must be 4-tuples of int",
+                                  &loc_type, &loc_index, &item_type, &item_index) ||
+                    !placement_append(out, loc_type, loc_index, item_type, item_index)) {
+                Py_DECREF(seq);
+                placement_arg_free(out);
+                return 0;
+            }
         }
-        Py_DECREF(release);
+        Py_DECREF(seq);
+        return 1;
     }
-cleanup:
-    Py_DECREF(osrc);
-    Py_DECREF(odst);
-    Py_DECREF(oplacement);
-error:
-    return pyres;
+    #undef PLACEMENT_LINE_MAX
 }
 
-static PyObject *
-PyList_from_requirements(const struct progression_requirement *first, size_t len)
+static const char *
+placement_open(placement_arg *arg, evermizer_context *ctx)
 {
-    PyObject *list = PyList_New(0);
-    if (list == NULL) return NULL;
+    /* returns path to pass to evermizer */
+    if (arg->path) return PyBytes_AS_STRING(arg->path);
+    memfile_init_read(&ctx->files[ctx->num_files++], MEMFILE_PLACEMENT, arg->text, arg->len);
+    return MEMFILE_PLACEMENT;
+}
 
-    for (size_t i = 0; i < len; i++) {
-        if (first[i].progress != P_NONE && first[i].pieces != 0) {
-            PyObject *pair = Py_BuildValue("ii", first[i].pieces,
-                                                 first[i].progress);
-            PyList_Append(list, pair);
-            Py_DECREF(pair);
-        } else {
-            break;
-        }
+typedef struct {
+    PyObject *path;   /* output file as ansi bytes, or */
+    Py_buffer view;   /* caller's writable buffer the output has to fit into, or */
+    PyObject *writer; /* object with write() that gets the output after the run */
+} output_arg;
+
+static void
+output_arg_free(output_arg *arg)
+{
+    Py_CLEAR(arg->path);
+    if (arg->view.obj) PyBuffer_Release(&arg->view);
+    Py_CLEAR(arg->writer);
+}
+
+static int
+output_from_pyobject(PyObject *o, void *result)
+{
+    /* output can be a path, a writable buffer, i.e. bytearray or mmap, or an object with write() */
+    output_arg *out = (output_arg *) result;
+    if (!o) {
+        /* later argument failed to parse */
+        output_arg_free(out);
+        return 1;
+    }
+    memset(out, 0, sizeof(*out));
+    if (PyBytes_Check(o) || PyUnicode_Check(o) || PyObject_HasAttrString(o, "__fspath__")) {
+        return path2ansi(o, &out->path) ? Py_CLEANUP_SUPPORTED : 0;
+    }
+    if (PyObject_CheckBuffer(o)) {
+        return PyObject_GetBuffer(o, &out->view, PyBUF_WRITABLE) == 0 ? Py_CLEANUP_SUPPORTED : 0;
+    }
+    if (PyObject_HasAttrString(o, "write")) {
+        Py_INCREF(o);
+        out->writer = o;
+        return Py_CLEANUP_SUPPORTED;
+    }
+    PyErr_SetString(PyExc_TypeError, "output must be a path, writable buffer or object with write()");
+    return 0;
+}
+
+static const char *
+output_open(output_arg *arg, evermizer_context *ctx, PyObject **collect)
+{
+    /* returns path to pass to evermizer. a buffer is written in place,
+       otherwise output is collected in a new bytearray *collect. NULL on error */
+    memfile *mf;
+    if (arg->path) return PyBytes_AS_STRING(arg->path);
+    mf = &ctx->files[ctx->num_files++];
+    if (arg->view.obj) {
+        memfile_init_fixed(mf, MEMFILE_DST, arg->view.buf, (size_t) arg->view.len);
+        return MEMFILE_DST;
+    }
+    /* evermizer writes directly into the bytearray, unless the output outgrows it */
+    *collect = PyByteArray_FromStringAndSize(NULL, ROM_SIZE_HINT);
+    if (!*collect) return NULL;
+    memfile_init_write(mf, MEMFILE_DST, PyByteArray_AS_STRING(*collect), ROM_SIZE_HINT);
+    return MEMFILE_DST;
+}
+
+static int
+output_check(const output_arg *arg, const memfile *mf)
+{
+    /* raise if the output did not fit into the caller's buffer */
+    if (!mf->fixed || !mf->error) return 0;
+    PyErr_Format(PyExc_ValueError, "Output does not fit into the buffer of %zd bytes", arg->view.len);
+    return -1;
+}
+
+static PyObject *
+output_bytearray(const memfile *mf, PyObject **collect)
+{
+    /* returns the output collected by output_open */
+    PyObject *res;
+    if (mf->owned) {
+        /* output did not fit into the preallocated buffer */
+        return PyByteArray_FromStringAndSize((const char*) mf->data, (Py_ssize_t) mf->size);
+    }
+    if (PyByteArray_Resize(*collect, (Py_ssize_t) mf->size) < 0) return NULL;
+    res = *collect;
+    *collect = NULL;
+    return res;
+}
+
+static int
+output_write(const output_arg *arg, PyObject *data)
+{
+    /* pass data to the writer. raw streams may write less than asked for, None counts as all */
+    PyObject *view = PyMemoryView_FromObject(data);
+    Py_ssize_t len, done = 0;
+    if (!view) return -1;
+    len = PyObject_Length(view);
+    while (done < len) {
+        PyObject *part = PySequence_GetSlice(view, done, len);
+        PyObject *res = part ? PyObject_CallMethod(arg->writer, "write", "(O)", part) : NULL;
+        Py_ssize_t n;
+        Py_XDECREF(part);
+        if (!res) goto error;
+        n = (res == Py_None) ? len - done : PyLong_AsSsize_t(res);
+        Py_DECREF(res);
+        if (n == -1 && PyErr_Occurred()) goto error;
+        if (n <= 0 || n > len - done) {
+            PyErr_Format(PyExc_OSError, "write() returned %zd", n);
+            goto error;
+        }
+        done += n;
+    }
+    Py_DECREF(view);
+    return 0;
+error:
+    Py_DECREF(view);
+    return -1;
+}
+
+static int
+seed_from_pyobject(PyObject *oseed, const char *pos, uint64_t *seed)
+{
+    *seed = (uint64_t)PyLong_AsUnsignedLongLong(oseed);
+    if (PyErr_Occurred()) {
+        PyErr_Clear();
+        PyErr_Format(PyExc_TypeError, "%s parameter 'seed' must be unsigned integer type, but got %s",
+                     pos, Py_TYPE(oseed)->tp_name);
+        return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    evermizer_context ctx;
+    const char *argv[25];
+    int argc;
+    int res;
+    PyObject *switches; /* private copy, keeps argv strings alive */
+    char sseed[21];
+    char sexp[5];
+    char smoney[5];
+    char id_buf[130]; /* hex(32B):hex(32B)\0 */
+    bool finished; /* run_finish was called */
+} evermizer_run;
+
+static int
+run_prepare(evermizer_run *run, const char *src, const char *dst, const char *placement,
+            const char *ap_seed, const char *ap_slot, uint64_t seed, const char *flags,
+            int money, int exp, PyObject *switches)
+{
+    /* original main signature:
+          int argc, char** argv: { <exe> [flags ...] <src.sfc> [settings [seed]] }
+       mapped main signature:
+          15, { "evermizer", '-b", "-o", "<dst.sfc>", "--money", "<money%>", "--exp', "<exp%>",
+               "--id", "<hex(32B ap seed)>[:]<hex(32B ap slot)>", "--placement", "<placement.txt>",
+               [switches...,]
+               "<src.sfc>", "<flags>", "<seed>" }
+       TODO: split UI/argument parsing from generation in evermizer, so we don't need to call the C main
+    */
+
+    char *id_bufp = run->id_buf;
+    PyObject *logging;
+    Py_ssize_t switches_len;
+    size_t argc;
+
+    stats_begin(&run->ctx.stats, PHASE_PREPARE);
+    run->ctx.src_path = src;
+    run->ctx.dst_path = dst;
+
+    snprintf(run->sseed, sizeof(run->sseed), "%" PRIx64, seed);
+
+    if (exp > 9999) exp = 9999;
+    if (exp < 0) exp = 0;
+    snprintf(run->sexp, sizeof(run->sexp), "%d", exp);
+
+    if (money > 9999) money = 9999;
+    if (money < 0) money = 0;
+    snprintf(run->smoney, sizeof(run->smoney), "%d", money);
+
+    memset(run->id_buf, 0, 130);
+    for (uint8_t i=0; i<32; i++) {
+        if (!ap_seed[i]) break;
+        *id_bufp++ = hexchars[((uint8_t)ap_seed[i]>>4)&0x0f];
+        *id_bufp++ = hexchars[((uint8_t)ap_seed[i]>>0)&0x0f];
+    }
+    *id_bufp++ = ':';
+    for (uint8_t i=0; i<32; i++) {
+        if (!ap_slot[i]) break;
+        *id_bufp++ = hexchars[((uint8_t)ap_slot[i]>>4)&0x0f];
+        *id_bufp++ = hexchars[((uint8_t)ap_slot[i]>>0)&0x0f];
+    }
+
+    /* keep a private copy of switches alive while the GIL is released */
+    run->switches = PySequence_Tuple(switches);
+    if (!run->switches) return -1;
+    switches_len = PyTuple_GET_SIZE(run->switches);
+    argc = 15 + switches_len;
+    if (argc >= ARRAY_SIZE(run->argv)) {
+        PyErr_SetString(PyExc_RuntimeError, "Too many switches to main!");
+        return -1;
+    }
+    run->argv[0] = "main";
+    run->argv[1] = "-b";
+    run->argv[2] = "-o";
+    run->argv[3] = dst;
+    run->argv[4] = "--money";
+    run->argv[5] = run->smoney;
+    run->argv[6] = "--exp";
+    run->argv[7] = run->sexp;
+    run->argv[8] = "--id";
+    run->argv[9] = run->id_buf;
+    run->argv[10] = "--placement";
+    run->argv[11] = placement;
+    for (Py_ssize_t i=0; i<switches_len; i++) {
+        PyObject* sw = PyTuple_GET_ITEM(run->switches, i);
+        run->argv[12+i] = PyUnicode_AsUTF8(sw);
+        if (!run->argv[12+i]) return -1;
+    }
+    run->argv[argc-3] = src;
+    run->argv[argc-2] = flags;
+    run->argv[argc-1] = run->sseed;
+    run->argc = (int)argc;
+
+    /* TODO: verify ap_seed is <= 32 bytes */
+
+    /* setup printf redirection */
+    logging = PyImport_ImportModule("logging");
+    if (!logging) return -1;
+    run->ctx.logger = PyObject_CallMethod(logging, "getLogger", "(s)", "SoE");
+    Py_DECREF(logging);
+    if (!run->ctx.logger) return -1;
+    if (context_init_log(&run->ctx) < 0) return -1;
+    stats_end(&run->ctx.stats);
+    return 0;
+}
+
+static void
+run_execute(evermizer_run *run)
+{
+    /* called without the GIL. no python calls in here */
+    evermizer_lock_enter(false);
+    current_context = &run->ctx;
+    stats_begin(&run->ctx.stats, PHASE_PARSE);
+    run->res = context_aborted() ? -1 : evermizer_main(run->argc, run->argv); /* may have been cancelled while waiting */
+    stats_end(&run->ctx.stats);
+    current_context = NULL;
+    evermizer_lock_leave();
+}
+
+static void
+run_finish(evermizer_run *run)
+{
+    /* send captured output to logger. freeing the capture is accounted to the run. only the first call does
+       anything, jobs call it before raising and again when they are freed */
+    evermizer_context *prev = current_context;
+    if (run->finished) return;
+    run->finished = true;
+    current_context = &run->ctx;
+    stats_end(&run->ctx.stats); /* prepare failed */
+    if (run->ctx.logger && !PyErr_Occurred()) {
+        stats_begin(&run->ctx.stats, PHASE_LOG);
+        context_emit_log(&run->ctx);
+        stats_end(&run->ctx.stats);
+    }
+    memfile_free(&run->ctx.log);
+    memfile_free(&run->ctx.stdout_line);
+    current_context = prev;
+
+    /* report stats once */
+    if (run->ctx.stats_dict && !PyErr_Occurred()) {
+        if (stats_fill_dict(&run->ctx.stats, run->res, run->ctx.stats_dict) < 0) PyErr_Clear();
+    }
+    Py_CLEAR(run->ctx.stats_dict);
+
+    /* cleanup */
+    Py_CLEAR(run->ctx.logger);
+    Py_CLEAR(run->switches);
+}
+
+static PyObject *
+run_main(evermizer_run *run, const char *src, const char *dst, const char *placement,
+         const char *ap_seed, const char *ap_slot, uint64_t seed, const char *flags,
+         int money, int exp, PyObject *switches)
+{
+    PyObject *pyres = NULL;
+    if (run_prepare(run, src, dst, placement, ap_seed, ap_slot, seed, flags, money, exp, switches) == 0) {
+        /* run generation without the GIL */
+        Py_BEGIN_ALLOW_THREADS
+        run_execute(run);
+        Py_END_ALLOW_THREADS
+        pyres = PyLong_FromLong(run->res);
+    }
+    run_finish(run);
+    return pyres;
+}
+
+/* methods */
+static int
+stats_from_pyobject(PyObject *stats, evermizer_context *ctx)
+{
+    /* optional dict that receives run_stats after the run */
+    stats_init(&ctx->stats);
+    if (stats == Py_None) return 0;
+    if (!PyDict_Check(stats)) {
+        PyErr_SetString(PyExc_TypeError, "stats must be a dict");
+        return -1;
+    }
+    Py_INCREF(stats);
+    ctx->stats_dict = stats;
+    return 0;
+}
+
+static PyObject *
+_evermizer_main(PyObject *self, PyObject *py_args, PyObject *kwargs)
+{
+    /* _evermizer.main call signature:
+        src: Path | RomHandle, dst: Path | Buffer | Writer, placement: Path | Sequence[Tuple[int, int, int, int]] | Buffer, apseed: str, apslot: str, seed: int, flags: str, money: int, exp: int, switches: list[str], *, stats: Optional[dict]
+       if stats is given, timing per phase and counters are stored in it after the run.
+       dst can be a path, a writable buffer the ROM is written into or an object with write() that gets the ROM
+    */
+
+    static const char *kwlist[] = {"src", "dst", "placement", "apseed", "apslot", "seed", "flags",
+                                   "money", "exp", "switches", "stats", NULL};
+
+    PyObject *pyres = NULL;
+    PyObject *osrcarg, *osrc = NULL;
+    PyObject *collect = NULL; /* output for a writer */
+    output_arg dst;
+    const char *dst_path;
+    memfile *dst_file;
+    placement_arg placement;
+    const char *ap_seed, *ap_slot;
+    PyObject *oseed; /* any integer -> PyObject */
+    PyObject *switches;
+    const char* flags;
+    const char *src;
+    PyObject *stats = Py_None;
+    uint64_t seed;
+    int money, exp;
+    evermizer_run run;
+
+    if (!PyArg_ParseTupleAndKeywords(py_args, kwargs, "OO&O&ssOsiiO|$O", (char**)kwlist, &osrcarg, output_from_pyobject, &dst,
+                                     placement_from_pyobject, &placement,
+                                     &ap_seed, &ap_slot, &oseed, &flags, &money, &exp, &switches, &stats)) {
+        goto error;
     }
 
-    return list;
+    memset(&run, 0, sizeof(run));
+    if (stats_from_pyobject(stats, &run.ctx) < 0) goto cleanup;
+    if (PyObject_TypeCheck(osrcarg, (PyTypeObject *) get_module_state(self)->RomHandleType)) {
+        /* src is a loaded ROM */
+        RomHandleObject *rom = (RomHandleObject *) osrcarg;
+        memfile_init_read(&run.ctx.files[run.ctx.num_files++], MEMFILE_SRC, rom->data, rom->size);
+        src = MEMFILE_SRC;
+    } else {
+        /* src is a path */
+        if (!path2ansi(osrcarg, &osrc)) goto cleanup;
+        src = PyBytes_AS_STRING(osrc);
+    }
+
+    if (!seed_from_pyobject(oseed, "6th", &seed)) goto cleanup;
+
+    dst_file = &run.ctx.files[run.ctx.num_files];
+    dst_path = output_open(&dst, &run.ctx, &collect);
+    if (!dst_path) goto cleanup;
+
+    pyres = run_main(&run, src, dst_path, placement_open(&placement, &run.ctx),
+                     ap_seed, ap_slot, seed, flags, money, exp, switches);
+    if (pyres && !dst.path) {
+        if (output_check(&dst, dst_file) < 0) {
+            Py_CLEAR(pyres);
+        } else if (dst.writer && run.res == 0 && !dst_file->error) {
+            PyObject *data = output_bytearray(dst_file, &collect);
+            if (!data || output_write(&dst, data) < 0) Py_CLEAR(pyres);
+            Py_XDECREF(data);
+        }
+    }
+
+cleanup:
+    Py_CLEAR(run.ctx.stats_dict); /* not run */
+    for (size_t i = 0; i < run.ctx.num_files; i++) memfile_free(&run.ctx.files[i]);
+    Py_XDECREF(collect);
+    Py_XDECREF(osrc);
+    output_arg_free(&dst);
+    placement_arg_free(&placement);
+error:
+    return pyres;
+}
+
+enum output_format {
+    OUTPUT_ROM,
+    OUTPUT_IPS,
+    OUTPUT_BPS
+};
+
+typedef struct {
+    evermizer_run run;
+    PyObject *args;   /* keeps argument strings alive */
+    PyObject *kwargs;
+    PyObject *out;    /* output bytearray */
+    Py_buffer src;
+    placement_arg placement;
+    output_arg dst;   /* caller's buffer or writer */
+    enum output_format format;
+    memfile patch;    /* IPS or BPS of the output against src */
+    enum patch_result patch_result;
+    bool prepared;
+} generate_job;
+
+static int
+output_format_from_string(const char *s, enum output_format *format)
+{
+    if (strcmp(s, "rom") == 0) *format = OUTPUT_ROM;
+    else if (strcmp(s, "ips") == 0) *format = OUTPUT_IPS;
+    else if (strcmp(s, "bps") == 0) *format = OUTPUT_BPS;
+    else {
+        PyErr_Format(PyExc_ValueError, "Invalid format '%s', expected 'rom', 'ips' or 'bps'", s);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+generate_job_init(generate_job *job, module_state *state, PyObject *args, PyObject *kwargs)
+{
+    /* parse arguments of generate() and prepare the in-memory run */
+    static const char *kwlist[] = {"src", "placement", "apseed", "apslot", "seed", "flags",
+                                   "money", "exp", "switches", "log", "stats", "format", "out", NULL};
+    PyObject *osrc;
+    PyObject *log = Py_None;
+    PyObject *stats = Py_None;
+    const char *format = "rom";
+    const char *ap_seed, *ap_slot;
+    PyObject *oseed;
+    PyObject *switches;
+    const char* flags;
+    uint64_t seed;
+    int money, exp;
+    evermizer_context *ctx = &job->run.ctx;
+
+    memset(job, 0, sizeof(*job));
+    stats_init(&ctx->stats);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO&ssOsiiO|$OOsO&", (char**)kwlist, &osrc,
+                                     placement_from_pyobject, &job->placement,
+                                     &ap_seed, &ap_slot, &oseed, &flags, &money, &exp, &switches, &log, &stats,
+                                     &format, output_from_pyobject, &job->dst)) {
+        return -1;
+    }
+    if (output_format_from_string(format, &job->format) < 0) return -1;
+    if (job->dst.path) {
+        PyErr_SetString(PyExc_TypeError, "out must be a writable buffer or object with write(), use main() for paths");
+        return -1;
+    }
+    if (stats_from_pyobject(stats, ctx) < 0) return -1;
+    if (log != Py_None) {
+        if (!PyList_Check(log)) {
+            PyErr_SetString(PyExc_TypeError, "log must be a list");
+            return -1;
+        }
+        Py_INCREF(log);
+        ctx->log_list = log;
+    }
+    Py_INCREF(args);
+    job->args = args;
+    Py_XINCREF(kwargs);
+    job->kwargs = kwargs;
+
+    if (!seed_from_pyobject(oseed, "5th", &seed)) return -1;
+
+    if (PyObject_TypeCheck(osrc, (PyTypeObject *) state->RomHandleType)) {
+        RomHandleObject *rom = (RomHandleObject *) osrc;
+        memfile_init_read(&ctx->files[0], MEMFILE_SRC, rom->data, rom->size);
+    } else {
+        /* like load_rom, evermizer and the patch base get the ROM without copier header */
+        size_t skip;
+        if (PyObject_GetBuffer(osrc, &job->src, PyBUF_SIMPLE) < 0) return -1;
+        skip = rom_copier_header_size((size_t)job->src.len);
+        memfile_init_read(&ctx->files[0], MEMFILE_SRC, (const char*)job->src.buf + skip, (size_t)job->src.len - skip);
+    }
+
+    ctx->num_files = 1;
+    if (job->format != OUTPUT_ROM) {
+        /* only bytes that differ from src are kept, the patch is built from those */
+        memfile_init_delta(&ctx->files[ctx->num_files++], MEMFILE_DST, ctx->files[0].rdata, ctx->files[0].size);
+        if (job->dst.view.obj) memfile_init_fixed(&job->patch, NULL, job->dst.view.buf, (size_t) job->dst.view.len);
+        else memfile_init_write(&job->patch, NULL, NULL, 0);
+    } else if (!output_open(&job->dst, ctx, &job->out)) {
+        return -1;
+    }
+
+    if (run_prepare(&job->run, MEMFILE_SRC, MEMFILE_DST, placement_open(&job->placement, ctx),
+                    ap_seed, ap_slot, seed, flags, money, exp, switches) < 0) {
+        return -1;
+    }
+    job->prepared = true;
+    return 0;
+}
+
+static void
+generate_job_execute(generate_job *job)
+{
+    /* called without the GIL. runs evermizer, then builds the patch if one was requested */
+    evermizer_context *ctx = &job->run.ctx;
+    memfile *dst = &ctx->files[1];
+    run_execute(&job->run);
+    if (job->format == OUTPUT_ROM) return;
+    if (job->run.res == 0 && !dst->error) {
+        stats_begin(&ctx->stats, PHASE_PATCH);
+        job->patch_result = (job->format == OUTPUT_IPS ? patch_ips : patch_bps)(dst, &job->patch);
+        stats_end(&ctx->stats);
+    }
+    /* the runs were allocated during the run, the patch is not */
+    current_context = ctx;
+    memfile_free(dst);
+    current_context = NULL;
+}
+
+static PyObject *
+generate_job_result(generate_job *job)
+{
+    /* returns output ROM or patch of a finished job, or with out its size. NULL and sets an exception on error */
+    memfile *dst = &job->run.ctx.files[1];
+    memfile *out = (job->format != OUTPUT_ROM) ? &job->patch : dst;
+    PyObject *data;
+    size_t size = out->size;
+    if (ABORT_FLAG_GET(&job->run.ctx.aborted)) {
+        PyErr_SetString(PyExc_RuntimeError, "ROM generation was cancelled");
+        return NULL;
+    }
+    if (job->patch_result == PATCH_IPS_RANGE) {
+        PyErr_SetString(PyExc_ValueError, "Output is larger than the 16 MiB that IPS can address, use format \"bps\"");
+        return NULL;
+    }
+    if (output_check(&job->dst, out) < 0) return NULL;
+    if (job->run.res != 0 || dst->error) {
+        PyErr_Format(PyExc_RuntimeError, "ROM generation failed with code %d", job->run.res);
+        return NULL;
+    }
+    if (out->error) return PyErr_NoMemory();
+    if (job->dst.view.obj) return PyLong_FromSize_t(size);
+    if (job->format != OUTPUT_ROM) data = PyBytes_FromStringAndSize((const char*) out->data, (Py_ssize_t) size);
+    else data = output_bytearray(out, &job->out);
+    if (!data || !job->dst.writer) return data;
+    if (output_write(&job->dst, data) < 0) {
+        Py_DECREF(data);
+        return NULL;
+    }
+    Py_DECREF(data);
+    return PyLong_FromSize_t(size);
+}
+
+static void
+generate_job_free(generate_job *job)
+{
+    evermizer_context *ctx = &job->run.ctx;
+    run_finish(&job->run);
+    for (size_t i = 0; i < ctx->num_files; i++) memfile_free(&ctx->files[i]);
+    memfile_free(&job->patch);
+    Py_CLEAR(job->out);
+    if (job->src.obj) PyBuffer_Release(&job->src);
+    placement_arg_free(&job->placement);
+    output_arg_free(&job->dst);
+    Py_CLEAR(job->args);
+    Py_CLEAR(job->kwargs);
+    Py_CLEAR(ctx->log_list);
+}
+
+#include "generatejob.h"
+
+static PyObject *
+_evermizer_generate(PyObject *self, PyObject *py_args, PyObject *kwargs)
+{
+    /* _evermizer.generate call signature:
+        src: Buffer | RomHandle, placement: Path | Sequence[Tuple[int, int, int, int]] | Buffer, apseed: str, apslot: str, seed: int, flags: str, money: int, exp: int, switches: list[str], *, log: Optional[list], stats: Optional[dict], format: str, out: Optional[Buffer | Writer]
+       returns the generated ROM as bytearray, or for format "ips" or "bps" a patch against src as bytes.
+       if out is given, the result is written into the buffer or passed to out.write() and its size is returned.
+       if log is given, (level, line) of evermizer's output are appended to it instead of being sent to the SoE logger. if stats is given, it is filled like for main
+    */
+
+    PyObject *pyres = NULL;
+    generate_job job;
+
+    if (generate_job_init(&job, get_module_state(self), py_args, kwargs) == 0) {
+        /* run generation without the GIL */
+        Py_BEGIN_ALLOW_THREADS
+        generate_job_execute(&job);
+        Py_END_ALLOW_THREADS
+        run_finish(&job.run); /* log before raising */
+        pyres = generate_job_result(&job);
+    }
+    generate_job_free(&job);
+    return pyres;
+}
+
+typedef struct {
+    generate_job *jobs;
+    size_t num_jobs;
+    size_t next_job;
+    int running;
+    PyThread_type_lock lock; /* protects next_job and running */
+    PyThread_type_lock done; /* held until all workers finished */
+} generate_pool;
+
+static void
+generate_pool_work(generate_pool *pool)
+{
+    /* run jobs until none are left. called without the GIL */
+    for (;;) {
+        generate_job *job = NULL;
+        PyThread_acquire_lock(pool->lock, WAIT_LOCK);
+        while (pool->next_job < pool->num_jobs && !job) {
+            job = &pool->jobs[pool->next_job++];
+            if (!job->prepared) job = NULL;
+        }
+        PyThread_release_lock(pool->lock);
+        if (!job) break;
+        generate_job_execute(job);
+    }
+    PyThread_acquire_lock(pool->lock, WAIT_LOCK);
+    if (--pool->running == 0) PyThread_release_lock(pool->done);
+    PyThread_release_lock(pool->lock);
+}
+
+static void
+generate_pool_thread(void *arg)
+{
+    /* generation does not touch python objects, so workers don't need a thread state */
+    generate_pool_work((generate_pool *) arg);
 }
 
 static PyObject *
-PyList_from_providers(const struct progression_provider *first, size_t len)
+_evermizer_generate_many(PyObject *self, PyObject *py_args, PyObject *kwargs)
 {
-    PyObject *list = PyList_New(0);
-    if (list == NULL) return NULL;
+    /* _evermizer.generate_many call signature:
+        jobs: Sequence[tuple | dict], workers: Optional[int]
+       each job is a tuple of positional or a dict of keyword arguments for generate()
+       returns a list with the output ROM or exception for each job, in the order of jobs
+    */
+
+    static const char *kwlist[] = {"jobs", "workers", NULL};
+    PyObject *ojobs, *oworkers = Py_None;
+    PyObject *seq = NULL;
+    PyObject *pyres = NULL;
+    PyObject *empty = NULL;
+    generate_pool pool;
+    Py_ssize_t n;
+    long workers;
+
+    if (!PyArg_ParseTupleAndKeywords(py_args, kwargs, "O|O", (char**)kwlist, &ojobs, &oworkers))
+        return NULL;
+
+    if (oworkers == Py_None) {
+        /* default to one worker per CPU */
+        PyObject *os = PyImport_ImportModule("os");
+        if (!os) return NULL;
+        oworkers = PyObject_CallMethod(os, "cpu_count", NULL);
+        Py_DECREF(os);
+        if (!oworkers) return NULL;
+        workers = (oworkers == Py_None) ? 1 : PyLong_AsLong(oworkers);
+        Py_DECREF(oworkers);
+    } else {
+        workers = PyLong_AsLong(oworkers);
+    }
+    if (workers == -1 && PyErr_Occurred()) return NULL;
+    if (workers < 1) {
+        PyErr_SetString(PyExc_ValueError, "workers must be at least 1");
+        return NULL;
+    }
 
-    for (size_t i = 0; i < len; i++) {
-        if (first[i].progress != P_NONE && first[i].pieces != 0) {
-            PyObject *pair = Py_BuildValue("ii", first[i].pieces,
-                                                 first[i].progress);
-            PyList_Append(list, pair);
-            Py_DECREF(pair);
+    seq = PySequence_Check(ojobs) ? PySequence_Tuple(ojobs) : NULL;
+    if (!seq) {
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "jobs must be a sequence");
+        return NULL;
+    }
+    n = PyTuple_GET_SIZE(seq);
+    pyres = PyList_New(n);
+    empty = PyTuple_New(0);
+    memset(&pool, 0, sizeof(pool));
+    pool.jobs = (generate_job *) PyMem_Calloc(n ? (size_t) n : 1, sizeof(generate_job));
+    pool.lock = PyThread_allocate_lock();
+    pool.done = PyThread_allocate_lock();
+    if (!pyres || !empty || !pool.jobs || !pool.lock || !pool.done) {
+        if (!PyErr_Occurred()) PyErr_NoMemory();
+        Py_CLEAR(pyres);
+        goto cleanup;
+    }
+    pool.num_jobs = (size_t) n;
+
+    /* parse jobs with the GIL held, failed jobs stay unprepared */
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *o = PyTuple_GET_ITEM(seq, i);
+        int res;
+        if (PyDict_Check(o)) {
+            PyObject *copy = PyDict_Copy(o); /* keep values alive */
+            res = copy ? generate_job_init(&pool.jobs[i], get_module_state(self), empty, copy) : -1;
+            Py_XDECREF(copy);
         } else {
-            break;
+            PyObject *tuple = PySequence_Tuple(o);
+            res = tuple ? generate_job_init(&pool.jobs[i], get_module_state(self), tuple, NULL) : -1;
+            Py_XDECREF(tuple);
+        }
+        if (res < 0) {
+            PyObject *type, *value, *tb;
+            PyErr_Fetch(&type, &value, &tb);
+            PyErr_NormalizeException(&type, &value, &tb);
+            if (tb) PyException_SetTraceback(value, tb);
+            Py_XDECREF(type);
+            Py_XDECREF(tb);
+            PyList_SET_ITEM(pyres, i, value);
+        }
+    }
+
+    /* run jobs on worker threads and this thread */
+    if ((Py_ssize_t) workers > n) workers = (long) n;
+    if (workers < 1) workers = 1;
+    pool.running = (int) workers;
+    PyThread_acquire_lock(pool.done, WAIT_LOCK);
+    for (long i = 1; i < workers; i++) {
+        if (PyThread_start_new_thread(generate_pool_thread, &pool) == PYTHREAD_INVALID_THREAD_ID) {
+            PyThread_acquire_lock(pool.lock, WAIT_LOCK);
+            pool.running--;
+            PyThread_release_lock(pool.lock);
+        }
+    }
+    Py_BEGIN_ALLOW_THREADS
+    generate_pool_work(&pool);
+    PyThread_acquire_lock(pool.done, WAIT_LOCK);
+    PyThread_acquire_lock(pool.lock, WAIT_LOCK); /* wait for the last worker to let go */
+    PyThread_release_lock(pool.lock);
+    PyThread_release_lock(pool.done);
+    Py_END_ALLOW_THREADS
+
+    /* collect results */
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *rom;
+        if (!pool.jobs[i].prepared) continue;
+        run_finish(&pool.jobs[i].run);
+        rom = generate_job_result(&pool.jobs[i]);
+        if (!rom) {
+            PyObject *type, *value, *tb;
+            PyErr_Fetch(&type, &value, &tb);
+            PyErr_NormalizeException(&type, &value, &tb);
+            Py_XDECREF(type);
+            Py_XDECREF(tb);
+            rom = value;
+        }
+        PyList_SET_ITEM(pyres, i, rom);
+    }
+
+cleanup:
+    if (pool.jobs) {
+        for (size_t i = 0; i < pool.num_jobs; i++) generate_job_free(&pool.jobs[i]);
+        PyMem_Free(pool.jobs);
+    }
+    if (pool.lock) PyThread_free_lock(pool.lock);
+    if (pool.done) PyThread_free_lock(pool.done);
+    Py_XDECREF(empty);
+    Py_DECREF(seq);
+    return pyres;
+}
+
+static PyObject *
+_evermizer_load_rom(PyObject *self, PyObject *arg)
+{
+    /* load and validate a ROM from str or PathLike path, or from a buffer. bytes are ROM data, not a path */
+    RomHandleObject *rom = PyObject_New(RomHandleObject, (PyTypeObject *) get_module_state(self)->RomHandleType);
+    int res;
+    if (!rom) return NULL;
+    rom->data = rom->base = NULL;
+    rom->size = rom->base_size = 0;
+    rom->owner = NULL;
+    rom->storage = ROM_STORAGE_HEAP;
+    if (PyUnicode_Check(arg) || PyObject_HasAttrString(arg, "__fspath__")) {
+        PyObject *opath;
+        if (!path2ansi(arg, &opath)) {
+            Py_DECREF(rom);
+            return NULL;
         }
+        res = RomHandle_load_file(rom, PyBytes_AS_STRING(opath));
+        Py_DECREF(opath);
+    } else {
+        res = RomHandle_load_buffer(rom, arg);
+    }
+    if (res < 0 || RomHandle_validate(rom) < 0) {
+        Py_DECREF(rom);
+        return NULL;
+    }
+    return (PyObject *) rom;
+}
+
+static int
+init_lookup(module_state *state)
+{
+    /* index the compiled tables once, in the same order the build_* functions create objects */
+    enum boss_drop_indices boss_drops[] = BOSS_DROPS;
+    const size_t ng = ARRAY_SIZE(gourd_data);
+    const size_t nb = ARRAY_SIZE(boss_names);
+    const size_t na = ARRAY_SIZE(alchemy_locations);
+    const size_t nl = ng + nb + na + ARRAY_SIZE(sniff_data);
+    const char **names = NULL;
+    uint32_t *values = NULL;
+    size_t n = 0;
+    int res = -1;
+
+    if (!pos_index_init(&state->location_pos, nl) ||
+            !pos_index_init(&state->item_pos, ARRAY_SIZE(gourd_drops_data) + ARRAY_SIZE(boss_drops) + na +
+                                              ARRAY_SIZE(extra_data) + ARRAY_SIZE(trap_data))) {
+        goto cleanup;
+    }
+    names = (const char**) PyMem_Calloc(nl, sizeof(*names));
+    values = (uint32_t*) PyMem_Calloc(nl, sizeof(*values));
+    if (!names || !values) goto cleanup;
+
+    for (size_t i = 0; i < ng; i++) {
+        values[n] = LOOKUP_VALUE(GET_LOCATIONS, n);
+        names[n++] = gourd_data[i].name;
+        pos_index_put(&state->location_pos, CHECK_GOURD, (unsigned) i, values[n-1]);
+    }
+    for (size_t i = 0; i < nb; i++) {
+        values[n] = LOOKUP_VALUE(GET_LOCATIONS, n);
+        names[n++] = boss_names[i];
+        pos_index_put(&state->location_pos, CHECK_BOSS, (unsigned) i, values[n-1]);
+    }
+    for (size_t i = 0; i < na; i++) {
+        values[n] = LOOKUP_VALUE(GET_LOCATIONS, n);
+        names[n++] = alchemy_locations[i].name;
+        pos_index_put(&state->location_pos, CHECK_ALCHEMY, (unsigned) i, values[n-1]);
     }
+    for (size_t i = 0, j = 0; i < ARRAY_SIZE(sniff_data); i++) {
+        if (unlikely(sniff_data[i].missable) || unlikely(sniff_data[i].excluded))
+            continue;
+        values[n] = LOOKUP_VALUE(GET_SNIFF_LOCATIONS, j++);
+        names[n++] = sniff_data[i].location_name;
+        pos_index_put(&state->location_pos, CHECK_SNIFF, (unsigned) i, values[n-1]);
+    }
+    if (!name_index_init(&state->location_names, names, values, n)) goto cleanup;
+
+    for (size_t i = 0; i < ARRAY_SIZE(gourd_drops_data); i++)
+        pos_index_put(&state->item_pos, CHECK_GOURD, (unsigned) i, LOOKUP_VALUE(GET_ITEMS, i));
+    for (size_t i = 0; i < ARRAY_SIZE(boss_drops); i++)
+        pos_index_put(&state->item_pos, CHECK_BOSS, (unsigned) boss_drops[i],
+                      LOOKUP_VALUE(GET_ITEMS, ARRAY_SIZE(gourd_drops_data) + i));
+    for (size_t i = 0; i < na; i++)
+        pos_index_put(&state->item_pos, CHECK_ALCHEMY, (unsigned) i,
+                      LOOKUP_VALUE(GET_ITEMS, ARRAY_SIZE(gourd_drops_data) + ARRAY_SIZE(boss_drops) + i));
+    for (size_t i = 0; i < ARRAY_SIZE(extra_data); i++)
+        pos_index_put(&state->item_pos, CHECK_EXTRA, (unsigned) i, LOOKUP_VALUE(GET_EXTRA_ITEMS, i));
+    for (size_t i = 0; i < ARRAY_SIZE(trap_data); i++)
+        pos_index_put(&state->item_pos, CHECK_TRAP, (unsigned) i, LOOKUP_VALUE(GET_TRAPS, i));
+    res = 0;
 
-    return list;
+cleanup:
+    PyMem_Free((void*) names);
+    PyMem_Free(values);
+    if (res < 0) PyErr_NoMemory();
+    return res;
 }
 
 static PyObject *
-_evermizer_get_locations(PyObject *self, PyObject *args)
+build_locations(PyObject *self)
 {
     const size_t ng = ARRAY_SIZE(gourd_data);
     const size_t nb = ARRAY_SIZE(boss_names);
@@ -362,7 +1775,7 @@ _evermizer_get_locations(PyObject *self, PyObject *args)
 
     for (size_t i = 0; i < ng; i++) {
         PyObject *args = Py_BuildValue("(s)", gourd_data[i].name);
-        PyObject *loc = PyObject_CallObject((PyObject *) &LocationType, args);
+        PyObject *loc = PyObject_CallObject(get_module_state(self)->LocationType, args);
         if (!loc) goto error;
         ((LocationObject*) loc)->type = CHECK_GOURD;
         ((LocationObject*) loc)->index = (unsigned short)i;
@@ -372,7 +1785,7 @@ _evermizer_get_locations(PyObject *self, PyObject *args)
 
     for (size_t i = 0; i < nb; i++) {
         PyObject *args = Py_BuildValue("(s)", boss_names[i]);
-        PyObject *loc = PyObject_CallObject((PyObject *) &LocationType, args);
+        PyObject *loc = PyObject_CallObject(get_module_state(self)->LocationType, args);
         if (!loc) goto error;
         ((LocationObject*) loc)->type = CHECK_BOSS;
         ((LocationObject*) loc)->index = (unsigned short)i;
@@ -382,7 +1795,7 @@ _evermizer_get_locations(PyObject *self, PyObject *args)
 
     for (size_t i = 0; i < na; i++) {
         PyObject *args = Py_BuildValue("(s)", alchemy_locations[i].name);
-        PyObject *loc = PyObject_CallObject((PyObject *) &LocationType, args);
+        PyObject *loc = PyObject_CallObject(get_module_state(self)->LocationType, args);
         if (!loc) goto error;
         ((LocationObject*) loc)->type = CHECK_ALCHEMY;
         ((LocationObject*) loc)->index = (unsigned short)i;
@@ -392,25 +1805,20 @@ _evermizer_get_locations(PyObject *self, PyObject *args)
 
     for (size_t i = 0; i < ARRAY_SIZE(blank_check_tree); i++) {
         const struct check_tree_item *check = blank_check_tree + i;
+        uint32_t pos;
         if (check->type == CHECK_SNIFF) continue; /* skip sniff */
-        for (size_t j = 0; j < location_count; j++) {
-            PyObject *o = PyList_GetItem(result, j);
-            if (!o) goto error;
-            if (((LocationObject*) o)->type != check->type) continue;
-            if (((LocationObject*) o)->index != check->index) continue;
+        if (pos_index_get(&get_module_state(self)->location_pos, check->type, check->index, &pos) &&
+                LOOKUP_LIST(pos) == GET_LOCATIONS) {
+            PyObject *o = PyList_GET_ITEM(result, LOOKUP_POS(pos));
             /* fill in requirements */
             if (check->requires[0].progress != P_NONE) {
-                PyObject *requirements = PyList_from_requirements(check->requires, ARRAY_SIZE(check->requires));
-                PyObject_SetAttrString(o, "requires", requirements);
-                assert(requirements->ob_refcnt == 2);
-                Py_DECREF(requirements);
+                copy_requirements(((LocationObject*) o)->requires, ARRAY_SIZE(((LocationObject*) o)->requires),
+                                  check->requires, ARRAY_SIZE(check->requires));
             }
             /* fill in progression */
             if (check->provides[0].progress != P_NONE) {
-                PyObject *provides = PyList_from_providers(check->provides, ARRAY_SIZE(check->provides));
-                PyObject_SetAttrString(o, "provides", provides);
-                assert(provides->ob_refcnt == 2);
-                Py_DECREF(provides);
+                copy_providers(((LocationObject*) o)->provides, ARRAY_SIZE(((LocationObject*) o)->provides),
+                               check->provides, ARRAY_SIZE(check->provides));
             }
             /* fill in difficulty (e.g. hidden chest) */
             ((LocationObject*) o)->difficulty = check->difficulty;
@@ -423,7 +1831,7 @@ error:
 }
 
 static PyObject *
-_evermizer_get_sniff_locations(PyObject *self, PyObject *args)
+build_sniff_locations(PyObject *self)
 {
     /* return list of sniff spots, that can optionally be assigned to */
     /* NOTE: this excludes missable ones and broken ones */
@@ -439,7 +1847,7 @@ _evermizer_get_sniff_locations(PyObject *self, PyObject *args)
         if (unlikely(sniff_data[i].missable) || unlikely(sniff_data[i].excluded))
             continue;
         PyObject *args = Py_BuildValue("(s)", sniff_data[i].location_name);
-        PyObject *loc = PyObject_CallObject((PyObject *) &LocationType, args);
+        PyObject *loc = PyObject_CallObject(get_module_state(self)->LocationType, args);
         if (!loc) goto error;
         ((LocationObject*) loc)->type = CHECK_SNIFF;
         ((LocationObject*) loc)->index = (unsigned short)i;
@@ -448,27 +1856,21 @@ _evermizer_get_sniff_locations(PyObject *self, PyObject *args)
         j++;
     }
 
-    /* iterate over both sniff locations and check tree to fill in progression
-     * both lists have ascending indices, so we can speed up the search */
-    size_t last_j = 0;
+    /* iterate over check tree to fill in progression */
     for (size_t i = 0; i < ARRAY_SIZE(blank_check_tree); i++) {
         const struct check_tree_item *check = blank_check_tree + i;
+        uint32_t pos;
         if (check->type != CHECK_SNIFF) continue; /* skip non-sniff */
-        for (size_t j = last_j; j < sniff_count; j++) {
-            PyObject *o = PyList_GetItem(result, j);
-            if (!o) goto error;
-            if (((LocationObject*) o)->index != check->index) continue;
+        if (pos_index_get(&get_module_state(self)->location_pos, check->type, check->index, &pos)) {
+            PyObject *o = PyList_GET_ITEM(result, LOOKUP_POS(pos));
             /* fill in requirements */
             if (check->requires[0].progress != P_NONE) {
-                PyObject *requirements = PyList_from_requirements(check->requires, ARRAY_SIZE(check->requires));
-                PyObject_SetAttrString(o, "requires", requirements);
-                assert(requirements->ob_refcnt == 2);
-                Py_DECREF(requirements);
+                copy_requirements(((LocationObject*) o)->requires, ARRAY_SIZE(((LocationObject*) o)->requires),
+                                  check->requires, ARRAY_SIZE(check->requires));
             }
             /* sniff spots don't have progression, so skipping that here */
             /* fill in difficulty (e.g. hidden chest) */
             ((LocationObject*) o)->difficulty = check->difficulty;
-            last_j = j;
         }
     }
 
@@ -517,7 +1919,7 @@ is_extra_actual_progress(const extra_item *extra)
 }
 
 static PyObject *
-_evermizer_get_items(PyObject *self, PyObject *args)
+build_items(PyObject *self)
 {
     /* return list of items that are part of the default pool */
     enum boss_drop_indices boss_drops[] = BOSS_DROPS;
@@ -529,7 +1931,7 @@ _evermizer_get_items(PyObject *self, PyObject *args)
 
     for (size_t i = 0; i < ng; i++) {
         PyObject *args = Py_BuildValue("(s)", gourd_drops_data[i].name);
-        PyObject *item = PyObject_CallObject((PyObject *) &ItemType, args);
+        PyObject *item = PyObject_CallObject(get_module_state(self)->ItemType, args);
         if (!item) goto error;
         ((ItemObject*) item)->type = CHECK_GOURD;
         ((ItemObject*) item)->index = (unsigned short)i;
@@ -539,7 +1941,7 @@ _evermizer_get_items(PyObject *self, PyObject *args)
 
     for (size_t i = 0; i < nb; i++) {
         PyObject *args = Py_BuildValue("(s)", boss_drop_names[boss_drops[i]]);
-        PyObject *item = PyObject_CallObject((PyObject *) &ItemType, args);
+        PyObject *item = PyObject_CallObject(get_module_state(self)->ItemType, args);
         if (!item) goto error;
         ((ItemObject*) item)->type = CHECK_BOSS;
         ((ItemObject*) item)->index = (unsigned short)boss_drops[i];
@@ -549,7 +1951,7 @@ _evermizer_get_items(PyObject *self, PyObject *args)
 
     for (size_t i = 0; i < na; i++) {
         PyObject *args = Py_BuildValue("(s)", alchemy_locations[i].name);
-        PyObject *item = PyObject_CallObject((PyObject *) &ItemType, args);
+        PyObject *item = PyObject_CallObject(get_module_state(self)->ItemType, args);
         if (!item) goto error;
         ((ItemObject*) item)->type = CHECK_ALCHEMY;
         ((ItemObject*) item)->index = (unsigned short)i;
@@ -559,19 +1961,16 @@ _evermizer_get_items(PyObject *self, PyObject *args)
 
     for (size_t i = 0; i < ARRAY_SIZE(drops); i++) {
         const struct drop_tree_item *drop = drops + i;
-        for (size_t j = 0; j < item_count; j++) {
-            PyObject* o = PyList_GetItem(result, j);
-            if (!o) goto error;
-            if (((ItemObject*) o)->type != drop->type) continue;
-            if (((ItemObject*) o)->index != drop->index) continue;
+        uint32_t pos;
+        if (pos_index_get(&get_module_state(self)->item_pos, drop->type, drop->index, &pos) &&
+                LOOKUP_LIST(pos) == GET_ITEMS) {
+            PyObject* o = PyList_GET_ITEM(result, LOOKUP_POS(pos));
             /* mark as progression item and fill in progression */
             if (drop->provides[0].progress != P_NONE) {
                 ((ItemObject*) o)->progression = is_drop_actual_progress(drop);
                 ((ItemObject*) o)->useful = true;
-                PyObject *provides = PyList_from_providers(drop->provides, ARRAY_SIZE(drop->provides));
-                PyObject_SetAttrString(o, "provides", provides);
-                assert(provides->ob_refcnt == 2);
-                Py_DECREF(provides);
+                copy_providers(((ItemObject*) o)->provides, ARRAY_SIZE(((ItemObject*) o)->provides),
+                               drop->provides, ARRAY_SIZE(drop->provides));
             }
         }
     }
@@ -582,7 +1981,7 @@ error:
 }
 
 static PyObject *
-_evermizer_get_sniff_items(PyObject *self, PyObject *args)
+build_sniff_items(PyObject *self)
 {
     /* return list of vanilla sniff spot items, that can optionally be shuffled */
     /* NOTE: this excludes missable ones and broken ones */
@@ -599,7 +1998,7 @@ _evermizer_get_sniff_items(PyObject *self, PyObject *args)
             continue;
         const struct sniff_data_item *data = sniff_data + i;
         PyObject *args = Py_BuildValue("(s)", get_item_name(data->item));
-        PyObject *item = PyObject_CallObject((PyObject *) &ItemType, args);
+        PyObject *item = PyObject_CallObject(get_module_state(self)->ItemType, args);
         if (!item) goto error;
         ((ItemObject*) item)->type = CHECK_SNIFF;
         ((ItemObject*) item)->index = data->item & 0x3ff;
@@ -616,7 +2015,7 @@ error:
 }
 
 static PyObject *
-_evermizer_get_extra_items(PyObject *self, PyObject *args)
+build_extra_items(PyObject *self)
 {
     /* return list of supported items that are not placed by default */
     const size_t extra_count = ARRAY_SIZE(extra_data);
@@ -625,17 +2024,15 @@ _evermizer_get_extra_items(PyObject *self, PyObject *args)
     for (size_t i = 0; i < extra_count; i++) {
         const struct extra_item *extra = extra_data + i;
         PyObject *args = Py_BuildValue("(s)", extra->name);
-        PyObject *item = PyObject_CallObject((PyObject *) &ItemType, args);
+        PyObject *item = PyObject_CallObject(get_module_state(self)->ItemType, args);
         if (!item) goto error;
         ((ItemObject*) item)->type = CHECK_EXTRA;
         ((ItemObject*) item)->index = (unsigned short)i;
         if (extra->provides[0].progress != P_NONE) {
             ((ItemObject*) item)->progression = is_extra_actual_progress(extra);
             ((ItemObject*) item)->useful = true;
-            PyObject *provides = PyList_from_providers(extra->provides, ARRAY_SIZE(extra->provides));
-            PyObject_SetAttrString(item, "provides", provides);
-            assert(provides->ob_refcnt == 2);
-            Py_DECREF(provides);
+            copy_providers(((ItemObject*) item)->provides, ARRAY_SIZE(((ItemObject*) item)->provides),
+                           extra->provides, ARRAY_SIZE(extra->provides));
         }
         Py_DECREF(args);
         PyList_SET_ITEM(result, i, item);
@@ -647,7 +2044,7 @@ error:
 }
 
 static PyObject *
-_evermizer_get_traps(PyObject *sef, PyObject *args)
+build_traps(PyObject *self)
 {
     /* return list of traps that are not placed by default */
     const size_t trap_count = ARRAY_SIZE(trap_data);
@@ -655,7 +2052,7 @@ _evermizer_get_traps(PyObject *sef, PyObject *args)
 
     for (size_t i = 0; i < trap_count; i++) {
         PyObject *args = Py_BuildValue("(s)", trap_data[i].name);
-        PyObject *item = PyObject_CallObject((PyObject *) &ItemType, args);
+        PyObject *item = PyObject_CallObject(get_module_state(self)->ItemType, args);
         if (!item) goto error;
         ((ItemObject*) item)->type = CHECK_TRAP;
         ((ItemObject*) item)->index = (unsigned short)i;
@@ -669,7 +2066,7 @@ error:
 }
 
 static PyObject *
-_evermizer_get_logic(PyObject *self, PyObject *args)
+build_logic(PyObject *self)
 {
     size_t n = 0;
     for (size_t i = 0; i < ARRAY_SIZE(blank_check_tree); i++) {
@@ -683,24 +2080,20 @@ _evermizer_get_logic(PyObject *self, PyObject *args)
         const struct check_tree_item *check = blank_check_tree + i;
         if (check->provides[0].progress == P_NONE) continue; /* skip locations with no direct progression in logic */
         PyObject *args = Py_BuildValue("(s)", "");
-        PyObject *loc = PyObject_CallObject((PyObject *) &LocationType, args);
+        PyObject *loc = PyObject_CallObject(get_module_state(self)->LocationType, args);
         if (!loc) goto error;
         ((LocationObject*) loc)->type = check->type;
         ((LocationObject*) loc)->index = check->index;
         Py_DECREF(args);
         /* fill in requirements */
         if (check->requires[0].progress != P_NONE) {
-            PyObject *requirements = PyList_from_requirements(check->requires, ARRAY_SIZE(check->requires));
-            PyObject_SetAttrString(loc, "requires", requirements);
-            assert(requirements->ob_refcnt == 2);
-            Py_DECREF(requirements);
+            copy_requirements(((LocationObject*) loc)->requires, ARRAY_SIZE(((LocationObject*) loc)->requires),
+                              check->requires, ARRAY_SIZE(check->requires));
         }
         /* fill in progression */
         if (check->provides[0].progress != P_NONE) {
-            PyObject *provides = PyList_from_providers(check->provides, ARRAY_SIZE(check->provides));
-            PyObject_SetAttrString(loc, "provides", provides);
-            assert(provides->ob_refcnt == 2);
-            Py_DECREF(provides);
+            copy_providers(((LocationObject*) loc)->provides, ARRAY_SIZE(((LocationObject*) loc)->provides),
+                           check->provides, ARRAY_SIZE(check->provides));
         }
         PyList_SET_ITEM(result, j, loc);
         j++;
@@ -711,55 +2104,1005 @@ error:
     return NULL;
 }
 
-/* module */
-static PyMethodDef _evermizer_methods[] = {
-    {"main", _evermizer_main, METH_VARARGS, "Run ROM generation"},
-    {"get_locations", _evermizer_get_locations, METH_NOARGS, "Returns list of \"regular\" locations"},
-    {"get_sniff_locations", _evermizer_get_sniff_locations, METH_NOARGS, "Returns list of sniff locations"},
-    {"get_items", _evermizer_get_items, METH_NOARGS, "Returns list of default items"},
-    {"get_sniff_items", _evermizer_get_sniff_items, METH_NOARGS, "Returns list of vanilla sniff items"},
-    {"get_extra_items", _evermizer_get_extra_items, METH_NOARGS, "Returns list of other items not placed by default"},
-    {"get_traps", _evermizer_get_traps, METH_NOARGS, "Returns trap items"},
-    {"get_logic", _evermizer_get_logic, METH_NOARGS, "Returns a list of real and pseudo locations that provide progression"},
-    {NULL, NULL, 0, NULL}        /* Sentinel */
+/* columnar export of the logic tables */
+enum logic_table {
+    TABLE_CHECK_TREE,
+    TABLE_DROPS,
+    TABLE_EXTRA,
+    LOGIC_TABLE_COUNT
 };
 
-static struct PyModuleDef _evermizer_module = {
-    PyModuleDef_HEAD_INIT,
-    "_evermizer", /* name of module */
-    NULL,         /* module documentation, may be NULL */
-    -1,           /* size of per-interpreter state of the module,
-                     or -1 if the module keeps state in global variables. */
-    _evermizer_methods
+static const char *const logic_table_names[LOGIC_TABLE_COUNT] = {
+    [TABLE_CHECK_TREE] = "blank_check_tree",
+    [TABLE_DROPS] = "drops",
+    [TABLE_EXTRA] = "extra_data",
 };
 
-PyMODINIT_FUNC
-PyInit__evermizer(void)
+#define MAX2(a, b) ((a) > (b) ? (a) : (b))
+#define REQUIRES_WIDTH ARRAY_SIZE(blank_check_tree[0].requires)
+#define PROVIDES_WIDTH MAX2(MAX2(ARRAY_SIZE(blank_check_tree[0].provides), ARRAY_SIZE(drops[0].provides)), \
+                            ARRAY_SIZE(extra_data[0].provides))
+
+/* rows of (pieces, progress) pairs are padded with (0, P_NONE) */
+#define PAD_PAIRS(row, width) do { \
+        for (size_t k = 0; k < (width); k++) { \
+            (row)[2*k] = 0; \
+            (row)[2*k+1] = P_NONE; \
+        } \
+    } while (0)
+
+/* copy (pieces, progress) pairs up to the first P_NONE into a padded row */
+#define FILL_PAIRS(row, width, pairs) do { \
+        PAD_PAIRS(row, width); \
+        for (size_t k = 0; k < ARRAY_SIZE(pairs) && k < (width); k++) { \
+            if ((pairs)[k].progress == P_NONE || (pairs)[k].pieces == 0) break; \
+            (row)[2*k] = (short) (pairs)[k].pieces; \
+            (row)[2*k+1] = (short) (pairs)[k].progress; \
+        } \
+    } while (0)
+
+static PyObject *
+build_columns(PyObject *self, enum logic_table table)
+{
+    /* returns dict of struct-of-arrays columns for one table */
+    PyTypeObject *type = (PyTypeObject *) get_module_state(self)->ColumnType;
+    const size_t n = (table == TABLE_CHECK_TREE) ? ARRAY_SIZE(blank_check_tree) :
+                     (table == TABLE_DROPS) ? ARRAY_SIZE(drops) : ARRAY_SIZE(extra_data);
+    Py_ssize_t shape[3] = {(Py_ssize_t) n, 0, 2};
+    ColumnObject *types, *indices, *difficulties, *requires = NULL, *provides = NULL;
+    PyObject *res = NULL;
+
+    types = Column_create(type, "i", sizeof(int), 1, shape);
+    indices = Column_create(type, "H", sizeof(unsigned short), 1, shape);
+    difficulties = Column_create(type, "b", sizeof(signed char), 1, shape);
+    shape[1] = REQUIRES_WIDTH;
+    requires = Column_create(type, "h", sizeof(short), 3, shape);
+    shape[1] = PROVIDES_WIDTH;
+    provides = Column_create(type, "h", sizeof(short), 3, shape);
+    if (!types || !indices || !difficulties || !requires || !provides) goto cleanup;
+
+    for (size_t i = 0; i < n; i++) {
+        int *t = (int*) types->data + i;
+        unsigned short *idx = (unsigned short*) indices->data + i;
+        signed char *difficulty = (signed char*) difficulties->data + i;
+        short *req = (short*) requires->data + i * REQUIRES_WIDTH * 2;
+        short *prov = (short*) provides->data + i * PROVIDES_WIDTH * 2;
+        if (table == TABLE_CHECK_TREE) {
+            const struct check_tree_item *check = blank_check_tree + i;
+            *t = check->type;
+            *idx = check->index;
+            *difficulty = (signed char) check->difficulty;
+            FILL_PAIRS(req, REQUIRES_WIDTH, check->requires);
+            FILL_PAIRS(prov, PROVIDES_WIDTH, check->provides);
+        } else if (table == TABLE_DROPS) {
+            const struct drop_tree_item *drop = drops + i;
+            *t = drop->type;
+            *idx = drop->index;
+            PAD_PAIRS(req, REQUIRES_WIDTH);
+            FILL_PAIRS(prov, PROVIDES_WIDTH, drop->provides);
+        } else {
+            *t = CHECK_EXTRA;
+            *idx = (unsigned short) i;
+            PAD_PAIRS(req, REQUIRES_WIDTH);
+            FILL_PAIRS(prov, PROVIDES_WIDTH, extra_data[i].provides);
+        }
+    }
+    res = Py_BuildValue("{sOsOsOsOsO}", "type", types, "index", indices, "difficulty", difficulties,
+                        "requires", requires, "provides", provides);
+
+cleanup:
+    Py_XDECREF(types);
+    Py_XDECREF(indices);
+    Py_XDECREF(difficulties);
+    Py_XDECREF(requires);
+    Py_XDECREF(provides);
+    return res;
+}
+
+static PyObject *
+_evermizer_get_columns(PyObject *self, PyObject *arg)
+{
+    const char *name = PyUnicode_Check(arg) ? PyUnicode_AsUTF8(arg) : NULL;
+    if (!name) {
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "table must be str");
+        return NULL;
+    }
+    for (int i = 0; i < LOGIC_TABLE_COUNT; i++) {
+        if (strcmp(name, logic_table_names[i]) == 0) {
+            PyObject *res;
+            evermizer_lock_enter(true);
+            res = build_columns(self, (enum logic_table) i);
+            evermizer_lock_leave();
+            return res;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown table %R", arg);
+    return NULL;
+}
+
+static PyObject *(*const cached_builders[CACHED_GETTER_COUNT])(PyObject *) = {
+    [GET_LOCATIONS] = build_locations,
+    [GET_SNIFF_LOCATIONS] = build_sniff_locations,
+    [GET_ITEMS] = build_items,
+    [GET_SNIFF_ITEMS] = build_sniff_items,
+    [GET_EXTRA_ITEMS] = build_extra_items,
+    [GET_TRAPS] = build_traps,
+    [GET_LOGIC] = build_logic,
+};
+
+static PyObject *
+get_cached(PyObject *self, enum cached_getter which)
+{
+    /* tables are constant, so results are built once per interpreter and shared as tuple of frozen objects */
+    module_state *state = get_module_state(self);
+    PyObject *list, *res;
+
+    PyThread_acquire_lock(state->cache_lock, WAIT_LOCK);
+    res = state->cache[which];
+    Py_XINCREF(res);
+    PyThread_release_lock(state->cache_lock);
+    if (res) return res;
+
+    evermizer_lock_enter(true);
+    list = cached_builders[which](self);
+    evermizer_lock_leave();
+    if (!list) return NULL;
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(list); i++) {
+        PyObject *o = PyList_GET_ITEM(list, i);
+        int err = PyObject_TypeCheck(o, (PyTypeObject *) state->LocationType)
+                  ? Location_freeze((LocationObject *) o) : Item_freeze((ItemObject *) o);
+        if (err < 0) {
+            Py_DECREF(list);
+            return NULL;
+        }
+    }
+    res = PyList_AsTuple(list);
+    Py_DECREF(list);
+    if (!res) return NULL;
+
+    /* another thread may have been faster, hand out the first result */
+    PyThread_acquire_lock(state->cache_lock, WAIT_LOCK);
+    if (state->cache[which]) {
+        Py_SETREF(res, state->cache[which]);
+        Py_INCREF(res);
+    } else {
+        state->cache[which] = res;
+        Py_INCREF(res);
+    }
+    PyThread_release_lock(state->cache_lock);
+    return res;
+}
+
+static PyObject *
+cached_getter(PyObject *self, PyObject *args, PyObject *kwargs, enum cached_getter which)
+{
+    /* copy=True builds a new list of mutable objects instead of returning the shared tuple */
+    static const char *kwlist[] = {"copy", NULL};
+    int copy = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", (char**)kwlist, &copy)) return NULL;
+    if (copy) {
+        PyObject *res;
+        evermizer_lock_enter(true);
+        res = cached_builders[which](self);
+        evermizer_lock_leave();
+        return res;
+    }
+    return get_cached(self, which);
+}
+
+#define CACHED_GETTER(name, which) \
+    static PyObject * \
+    _evermizer_get_##name(PyObject *self, PyObject *args, PyObject *kwargs) \
+    { \
+        return cached_getter(self, args, kwargs, which); \
+    }
+
+CACHED_GETTER(locations, GET_LOCATIONS)
+CACHED_GETTER(sniff_locations, GET_SNIFF_LOCATIONS)
+CACHED_GETTER(items, GET_ITEMS)
+CACHED_GETTER(sniff_items, GET_SNIFF_ITEMS)
+CACHED_GETTER(extra_items, GET_EXTRA_ITEMS)
+CACHED_GETTER(traps, GET_TRAPS)
+CACHED_GETTER(logic, GET_LOGIC)
+
+static PyObject *
+lookup_result(PyObject *self, uint32_t value)
+{
+    /* returns the shared object at a looked up position */
+    PyObject *list = get_cached(self, (enum cached_getter) LOOKUP_LIST(value));
+    PyObject *res;
+    if (!list) return NULL;
+    res = PyTuple_GET_ITEM(list, LOOKUP_POS(value));
+    Py_INCREF(res);
+    Py_DECREF(list);
+    return res;
+}
+
+static PyObject *
+lookup_by_pos(PyObject *self, PyObject *args, const pos_index *idx)
+{
+    int type;
+    unsigned short index;
+    uint32_t value;
+    if (!PyArg_ParseTuple(args, "iH", &type, &index)) return NULL;
+    if (!pos_index_get(idx, type, index, &value)) {
+        PyErr_Format(PyExc_KeyError, "(%d, %d)", type, (int) index);
+        return NULL;
+    }
+    return lookup_result(self, value);
+}
+
+static PyObject *
+_evermizer_get_location(PyObject *self, PyObject *args)
+{
+    return lookup_by_pos(self, args, &get_module_state(self)->location_pos);
+}
+
+static PyObject *
+_evermizer_get_item(PyObject *self, PyObject *args)
+{
+    return lookup_by_pos(self, args, &get_module_state(self)->item_pos);
+}
+
+static PyObject *
+_evermizer_get_location_by_name(PyObject *self, PyObject *arg)
+{
+    const char *name;
+    Py_ssize_t len;
+    uint32_t value;
+    if (!PyUnicode_Check(arg)) {
+        PyErr_SetString(PyExc_TypeError, "name must be str");
+        return NULL;
+    }
+    name = PyUnicode_AsUTF8AndSize(arg, &len);
+    if (!name) return NULL;
+    if (!name_index_get(&get_module_state(self)->location_names, name, (size_t) len, &value)) {
+        PyErr_SetObject(PyExc_KeyError, arg);
+        return NULL;
+    }
+    return lookup_result(self, value);
+}
+
+static PyObject *
+_evermizer_sweep(PyObject *self, PyObject *arg)
 {
-    PyObject *m;
-    PyObject *threading;
+    /* _evermizer.sweep call signature:
+        progress_counts: Sequence[int] | ProgressionState
+       returns (reachable locations as list of (type, index), counts per progression after collecting them) */
+    module_state *state = get_module_state(self);
+    const logic_graph *g = &state->logic;
+    PyObject *seq, *locations = NULL, *final_counts = NULL;
+    long *counts = NULL;
+    bool *reached = NULL;
+    Py_ssize_t len, n;
+
+    if (Py_IS_TYPE(arg, (PyTypeObject *) state->ProgressionStateType)) {
+        /* copy counts directly */
+        ProgressionStateObject *progress = (ProgressionStateObject *) arg;
+        seq = NULL;
+        len = Py_SIZE(progress);
+        n = len;
+        counts = (long*) PyMem_Calloc((size_t) n, sizeof(*counts));
+        reached = (bool*) PyMem_Calloc(g->num_checks + 1, sizeof(*reached));
+        if (!counts || !reached) {
+            PyErr_NoMemory();
+            goto cleanup;
+        }
+        for (Py_ssize_t i = 0; i < len; i++) counts[i] = progress->counts[i];
+        goto run;
+    }
+    seq = PySequence_Fast(arg, "progress_counts must be a sequence");
+    if (!seq) return NULL;
+    len = PySequence_Fast_GET_SIZE(seq);
+    n = (len > (Py_ssize_t) g->num_progressions) ? len : (Py_ssize_t) g->num_progressions;
+    counts = (long*) PyMem_Calloc((size_t) n, sizeof(*counts));
+    reached = (bool*) PyMem_Calloc(g->num_checks + 1, sizeof(*reached));
+    if (!counts || !reached) {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+    for (Py_ssize_t i = 0; i < len; i++) {
+        counts[i] = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+        if (counts[i] == -1 && PyErr_Occurred()) goto cleanup;
+    }
 
-    if (PyType_Ready(&LocationType) < 0) return NULL;
-    if (PyType_Ready(&ItemType) < 0) return NULL;
+run:
+    if (!logic_sweep(g, counts, reached)) {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
 
-    m = PyModule_Create(&_evermizer_module);
-    if (!m) return NULL;
+    /* report real locations only, pseudo locations are visible through the counts */
+    locations = PyList_New(0);
+    if (!locations) goto cleanup;
+    for (size_t i = 0; i < g->num_checks; i++) {
+        const struct check_tree_item *check = g->checks + i;
+        uint32_t pos;
+        PyObject *id;
+        if (!reached[i] || !pos_index_get(&state->location_pos, check->type, check->index, &pos)) continue;
+        id = Py_BuildValue("(ii)", (int) check->type, (int) check->index);
+        if (!id || PyList_Append(locations, id) < 0) {
+            Py_XDECREF(id);
+            Py_CLEAR(locations);
+            goto cleanup;
+        }
+        Py_DECREF(id);
+    }
+    final_counts = PyList_New(n);
+    if (!final_counts) {
+        Py_CLEAR(locations);
+        goto cleanup;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *count = PyLong_FromLong(counts[i]);
+        if (!count) {
+            Py_CLEAR(locations);
+            Py_CLEAR(final_counts);
+            goto cleanup;
+        }
+        PyList_SET_ITEM(final_counts, i, count);
+    }
 
-    Py_INCREF(&LocationType);
-    if (PyModule_AddObject(m, "Location", (PyObject *) &LocationType) < 0)
-    {
-        Py_DECREF(&LocationType);
-        goto type_error;
+cleanup:
+    PyMem_Free(counts);
+    PyMem_Free(reached);
+    Py_XDECREF(seq);
+    if (!locations) return NULL;
+    return Py_BuildValue("(NN)", locations, final_counts);
+}
+
+/* pickling. Location and Item reduce to their (type, index) and the fields that differ from the shared object
+   of get_location() or get_item(). frozen objects without changes unpickle to the shared object itself */
+enum pickle_kind {
+    PICKLE_LOCATION,
+    PICKLE_ITEM,
+};
+
+static PyObject *
+pickle_module(PyTypeObject *tp)
+{
+    /* returns borrowed module of Location or Item, also for subclasses defined in Python */
+    for (; tp; tp = tp->tp_base) {
+        PyObject *module;
+        if (!(tp->tp_flags & Py_TPFLAGS_HEAPTYPE)) continue;
+        module = PyType_GetModule(tp);
+        if (module) return module;
+        PyErr_Clear();
     }
-    Py_INCREF(&ItemType);
-    if (PyModule_AddObject(m, "Item", (PyObject *) &ItemType) < 0)
-    {
-        Py_DECREF(&ItemType);
-        goto type_error;
+    PyErr_SetString(PyExc_TypeError, "Not a pyevermizer type");
+    return NULL;
+}
+
+static PyObject *
+shared_object(PyObject *module, enum pickle_kind kind, int type, unsigned index)
+{
+    /* returns new reference or NULL without exception if there is no shared object */
+    module_state *state = get_module_state(module);
+    uint32_t value;
+    if (!pos_index_get(kind == PICKLE_LOCATION ? &state->location_pos : &state->item_pos, type, index, &value))
+        return NULL;
+    return lookup_result(module, value);
+}
+
+static int
+delta_set(PyObject *delta, const char *key, PyObject *value)
+{
+    /* steals value */
+    int res = value ? PyDict_SetItemString(delta, key, value) : -1;
+    Py_XDECREF(value);
+    return res;
+}
+
+static int
+delta_name(PyObject *delta, PyObject *name, PyObject *base_name)
+{
+    int same = 0;
+    if (!name) return 0;
+    if (base_name) {
+        same = PyObject_RichCompareBool(name, base_name, Py_EQ);
+        if (same < 0) return -1;
+    }
+    return same ? 0 : PyDict_SetItemString(delta, "name", name);
+}
+
+static PyObject *
+location_delta(LocationObject *self, LocationObject *base)
+{
+    /* dict of fields that differ from base, all fields without base */
+    PyObject *delta = PyDict_New();
+    if (!delta) return NULL;
+    if (delta_name(delta, self->name, base ? base->name : NULL) < 0) goto error;
+    if ((!base || self->difficulty != base->difficulty) &&
+            delta_set(delta, "difficulty", PyLong_FromLong(self->difficulty)) < 0) goto error;
+    if ((!base || !same_requirements(self->requires, base->requires, ARRAY_SIZE(self->requires))) &&
+            delta_set(delta, "requires", tuple_from_requirements(self->requires, ARRAY_SIZE(self->requires))) < 0)
+        goto error;
+    if ((!base || !same_providers(self->provides, base->provides, ARRAY_SIZE(self->provides))) &&
+            delta_set(delta, "provides", tuple_from_providers(self->provides, ARRAY_SIZE(self->provides))) < 0)
+        goto error;
+    return delta;
+error:
+    Py_DECREF(delta);
+    return NULL;
+}
+
+static PyObject *
+item_delta(ItemObject *self, ItemObject *base)
+{
+    /* dict of fields that differ from base, all fields without base */
+    PyObject *delta = PyDict_New();
+    if (!delta) return NULL;
+    if (delta_name(delta, self->name, base ? base->name : NULL) < 0) goto error;
+    if ((!base || self->progression != base->progression) &&
+            delta_set(delta, "progression", PyBool_FromLong(self->progression)) < 0) goto error;
+    if ((!base || self->useful != base->useful) &&
+            delta_set(delta, "useful", PyBool_FromLong(self->useful)) < 0) goto error;
+    if ((!base || !same_providers(self->provides, base->provides, ARRAY_SIZE(self->provides))) &&
+            delta_set(delta, "provides", tuple_from_providers(self->provides, ARRAY_SIZE(self->provides))) < 0)
+        goto error;
+    return delta;
+error:
+    Py_DECREF(delta);
+    return NULL;
+}
+
+static PyObject *
+reduce_table_object(PyObject *self, enum pickle_kind kind)
+{
+    /* (restore, (type, index, frozen, delta or None[, subclass])[, __dict__]) */
+    PyObject *module = pickle_module(Py_TYPE(self));
+    module_state *state;
+    PyTypeObject *base_type;
+    PyObject *base, *delta, *restore, *args, *dict = NULL;
+    int type, frozen;
+    unsigned short index;
+    if (!module) return NULL;
+    state = get_module_state(module);
+    if (kind == PICKLE_LOCATION) {
+        type = (int) ((LocationObject *) self)->type;
+        index = ((LocationObject *) self)->index;
+        frozen = ((LocationObject *) self)->frozen;
+        base_type = (PyTypeObject *) state->LocationType;
+    } else {
+        type = (int) ((ItemObject *) self)->type;
+        index = ((ItemObject *) self)->index;
+        frozen = ((ItemObject *) self)->frozen;
+        base_type = (PyTypeObject *) state->ItemType;
+    }
+    base = shared_object(module, kind, type, index);
+    if (!base && PyErr_Occurred()) return NULL;
+    delta = (kind == PICKLE_LOCATION) ? location_delta((LocationObject *) self, (LocationObject *) base)
+                                      : item_delta((ItemObject *) self, (ItemObject *) base);
+    Py_XDECREF(base);
+    if (!delta) return NULL;
+    if (PyDict_GET_SIZE(delta) == 0) {
+        Py_DECREF(delta);
+        delta = Py_None;
+        Py_INCREF(delta);
     }
+    restore = PyObject_GetAttrString(module, kind == PICKLE_LOCATION ? "_restore_location" : "_restore_item");
+    if (!restore) {
+        Py_DECREF(delta);
+        return NULL;
+    }
+    if (Py_TYPE(self) == base_type) {
+        args = Py_BuildValue("(iHON)", type, (int) index, frozen ? Py_True : Py_False, delta);
+    } else {
+        /* subclass, keep its instance dict */
+        args = Py_BuildValue("(iHONO)", type, (int) index, frozen ? Py_True : Py_False, delta, Py_TYPE(self));
+        dict = PyObject_GetAttrString(self, "__dict__");
+        if (!dict) PyErr_Clear();
+    }
+    if (!args) {
+        Py_DECREF(restore);
+        Py_XDECREF(dict);
+        return NULL;
+    }
+    if (dict) return Py_BuildValue("(NNN)", restore, args, dict);
+    return Py_BuildValue("(NN)", restore, args);
+}
+
+static PyObject *
+Location_reduce_ex(PyObject *self, PyObject *protocol)
+{
+    return reduce_table_object(self, PICKLE_LOCATION);
+}
+
+static PyObject *
+Item_reduce_ex(PyObject *self, PyObject *protocol)
+{
+    return reduce_table_object(self, PICKLE_ITEM);
+}
+
+static PyObject *
+new_table_object(PyTypeObject *type, enum pickle_kind kind, PyObject *base)
+{
+    /* new Location or Item without calling __init__, with the fields of base if given */
+    PyObject *empty = PyTuple_New(0);
+    PyObject *o;
+    if (!empty) return NULL;
+    o = type->tp_new(type, empty, NULL);
+    Py_DECREF(empty);
+    if (!o || !base) return o;
+    if (kind == PICKLE_LOCATION) {
+        LocationObject *dst = (LocationObject *) o, *src = (LocationObject *) base;
+        Py_XINCREF(src->name);
+        Py_XSETREF(dst->name, src->name);
+        dst->type = src->type;
+        dst->index = src->index;
+        dst->difficulty = src->difficulty;
+        memcpy(dst->requires, src->requires, sizeof(dst->requires));
+        memcpy(dst->provides, src->provides, sizeof(dst->provides));
+    } else {
+        ItemObject *dst = (ItemObject *) o, *src = (ItemObject *) base;
+        Py_XINCREF(src->name);
+        Py_XSETREF(dst->name, src->name);
+        dst->type = src->type;
+        dst->index = src->index;
+        dst->progression = src->progression;
+        dst->useful = src->useful;
+        memcpy(dst->provides, src->provides, sizeof(dst->provides));
+    }
+    return o;
+}
+
+static int
+apply_delta(PyObject *o, enum pickle_kind kind, PyObject *delta)
+{
+    /* set fields from a dict of location_delta() or item_delta(), also the read-only ones */
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(delta, &pos, &key, &value)) {
+        const char *name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+        int res = 0;
+        if (!name) {
+            if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "Field names must be str");
+            return -1;
+        }
+        if (strcmp(name, "name") == 0) {
+            PyObject **dst = (kind == PICKLE_LOCATION) ? &((LocationObject *) o)->name : &((ItemObject *) o)->name;
+            Py_INCREF(value);
+            Py_XSETREF(*dst, value);
+        } else if (kind == PICKLE_LOCATION && strcmp(name, "difficulty") == 0) {
+            long v = PyLong_AsLong(value);
+            if (v == -1 && PyErr_Occurred()) return -1;
+            ((LocationObject *) o)->difficulty = (char) v;
+        } else if (kind == PICKLE_LOCATION && strcmp(name, "requires") == 0) {
+            res = requirements_from_sequence(((LocationObject *) o)->requires,
+                                             ARRAY_SIZE(((LocationObject *) o)->requires), value);
+        } else if (kind == PICKLE_LOCATION && strcmp(name, "provides") == 0) {
+            res = providers_from_sequence(((LocationObject *) o)->provides,
+                                          ARRAY_SIZE(((LocationObject *) o)->provides), value);
+        } else if (kind == PICKLE_ITEM && strcmp(name, "progression") == 0) {
+            res = PyObject_IsTrue(value);
+            if (res >= 0) ((ItemObject *) o)->progression = (char) res;
+        } else if (kind == PICKLE_ITEM && strcmp(name, "useful") == 0) {
+            res = PyObject_IsTrue(value);
+            if (res >= 0) ((ItemObject *) o)->useful = (char) res;
+        } else if (kind == PICKLE_ITEM && strcmp(name, "provides") == 0) {
+            res = providers_from_sequence(((ItemObject *) o)->provides,
+                                          ARRAY_SIZE(((ItemObject *) o)->provides), value);
+        } else {
+            PyErr_Format(PyExc_ValueError, "Unknown field %R", key);
+            return -1;
+        }
+        if (res < 0) return -1;
+    }
+    return 0;
+}
+
+static PyObject *
+restore_table_object(PyObject *self, PyObject *args, enum pickle_kind kind)
+{
+    module_state *state = get_module_state(self);
+    PyTypeObject *type = (PyTypeObject *) (kind == PICKLE_LOCATION ? state->LocationType : state->ItemType);
+    PyObject *delta, *cls = NULL, *base, *o;
+    int check_type, frozen;
+    unsigned short index;
+    if (!PyArg_ParseTuple(args, "iHpO|O", &check_type, &index, &frozen, &delta, &cls)) return NULL;
+    if (cls && (!PyType_Check(cls) || !PyType_IsSubtype((PyTypeObject *) cls, type))) {
+        PyErr_Format(PyExc_TypeError, "Expected subclass of %s", type->tp_name);
+        return NULL;
+    }
+    if (delta != Py_None && !PyDict_Check(delta)) {
+        PyErr_SetString(PyExc_TypeError, "Expected dict of changed fields or None");
+        return NULL;
+    }
+    base = shared_object(self, kind, check_type, index);
+    if (!base && PyErr_Occurred()) return NULL;
+    if (base && frozen && !cls && delta == Py_None) return base; /* unchanged shared object */
+    o = new_table_object(cls ? (PyTypeObject *) cls : type, kind, base);
+    Py_XDECREF(base);
+    if (!o) return NULL;
+    if (kind == PICKLE_LOCATION) {
+        ((LocationObject *) o)->type = (enum check_tree_item_type) check_type;
+        ((LocationObject *) o)->index = index;
+    } else {
+        ((ItemObject *) o)->type = (enum check_tree_item_type) check_type;
+        ((ItemObject *) o)->index = index;
+    }
+    if (delta != Py_None && apply_delta(o, kind, delta) < 0) {
+        Py_DECREF(o);
+        return NULL;
+    }
+    if (kind == PICKLE_LOCATION) ((LocationObject *) o)->frozen = (char) frozen;
+    else ((ItemObject *) o)->frozen = (char) frozen;
+    return o;
+}
+
+static PyObject *
+_evermizer_restore_location(PyObject *self, PyObject *args)
+{
+    return restore_table_object(self, args, PICKLE_LOCATION);
+}
+
+static PyObject *
+_evermizer_restore_item(PyObject *self, PyObject *args)
+{
+    return restore_table_object(self, args, PICKLE_ITEM);
+}
+
+/* pack() buffer: header, fixed size records, utf-8 names of the records that don't use the shared name */
+#define PACKED_MAGIC "EVMP"
+#define PACKED_VERSION 1
+#define PACKED_PROVIDES_LEN MAX2(LOCATION_PROVIDES_LEN, ITEM_PROVIDES_LEN)
+
+enum packed_flags {
+    PACKED_FROZEN = 1,
+    PACKED_PROGRESSION = 2,
+    PACKED_USEFUL = 4,
+    PACKED_SHARED_NAME = 8,
+};
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size; /* depends on the size of evermizer's tables */
+    uint32_t count;
+} packed_header;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t flags;
+    int8_t difficulty;
+    uint8_t reserved;
+    int32_t type;
+    uint32_t index;
+    uint32_t name_len;
+    int32_t requires[LOCATION_REQUIRES_LEN][2]; /* (pieces, progress) */
+    int32_t provides[PACKED_PROVIDES_LEN][2];
+} packed_record;
+
+static int
+pack_record(PyObject *module, PyObject *o, packed_record *rec, const char **name, Py_ssize_t *name_len)
+{
+    /* fill rec from Location or Item o. name is set if it has to be stored */
+    module_state *state = get_module_state(module);
+    enum pickle_kind kind;
+    PyObject *oname, *base;
+    int same = 0;
+    memset(rec, 0, sizeof(*rec));
+    *name = NULL;
+    *name_len = 0;
+    if (Py_IS_TYPE(o, (PyTypeObject *) state->LocationType)) {
+        LocationObject *loc = (LocationObject *) o;
+        kind = PICKLE_LOCATION;
+        rec->flags = loc->frozen ? PACKED_FROZEN : 0;
+        rec->difficulty = (int8_t) loc->difficulty;
+        rec->type = (int32_t) loc->type;
+        rec->index = loc->index;
+        for (size_t i = 0; i < ARRAY_SIZE(loc->requires); i++) {
+            rec->requires[i][0] = (int32_t) loc->requires[i].pieces;
+            rec->requires[i][1] = (int32_t) loc->requires[i].progress;
+        }
+        for (size_t i = 0; i < ARRAY_SIZE(loc->provides); i++) {
+            rec->provides[i][0] = (int32_t) loc->provides[i].pieces;
+            rec->provides[i][1] = (int32_t) loc->provides[i].progress;
+        }
+        oname = loc->name;
+    } else if (Py_IS_TYPE(o, (PyTypeObject *) state->ItemType)) {
+        ItemObject *item = (ItemObject *) o;
+        kind = PICKLE_ITEM;
+        rec->flags = (item->frozen ? PACKED_FROZEN : 0) | (item->progression ? PACKED_PROGRESSION : 0) |
+                     (item->useful ? PACKED_USEFUL : 0);
+        rec->type = (int32_t) item->type;
+        rec->index = item->index;
+        for (size_t i = 0; i < ARRAY_SIZE(item->provides); i++) {
+            rec->provides[i][0] = (int32_t) item->provides[i].pieces;
+            rec->provides[i][1] = (int32_t) item->provides[i].progress;
+        }
+        oname = item->name;
+    } else {
+        PyErr_Format(PyExc_TypeError, "Can only pack Location and Item, not %s", Py_TYPE(o)->tp_name);
+        return -1;
+    }
+    rec->kind = (uint8_t) kind;
+    if (!oname || !PyUnicode_Check(oname)) {
+        PyErr_SetString(PyExc_TypeError, "Can only pack objects with str name");
+        return -1;
+    }
+    base = shared_object(module, kind, rec->type, rec->index);
+    if (!base && PyErr_Occurred()) return -1;
+    if (base) {
+        PyObject *base_name = (kind == PICKLE_LOCATION) ? ((LocationObject *) base)->name : ((ItemObject *) base)->name;
+        same = base_name ? PyObject_RichCompareBool(oname, base_name, Py_EQ) : 0;
+        Py_DECREF(base);
+        if (same < 0) return -1;
+    }
+    if (same) {
+        rec->flags |= PACKED_SHARED_NAME;
+        return 0;
+    }
+    *name = PyUnicode_AsUTF8AndSize(oname, name_len);
+    if (!*name) return -1;
+    if ((size_t) *name_len > UINT32_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "name too long");
+        return -1;
+    }
+    rec->name_len = (uint32_t) *name_len;
+    return 0;
+}
+
+static PyObject *
+_evermizer_pack(PyObject *self, PyObject *arg)
+{
+    /* _evermizer.pack call signature:
+        objects: Sequence[Location | Item]
+       returns Packed, names equal to the shared object's are not stored */
+    PyObject *seq = PySequence_Fast(arg, "pack() takes a sequence of Location and Item");
+    packed_record *records = NULL;
+    const char **names = NULL;
+    Py_ssize_t *name_lens = NULL;
+    PyObject *data = NULL;
+    PackedObject *res = NULL;
+    packed_header header;
+    size_t n, total;
+    char *p;
+    if (!seq) return NULL;
+    n = (size_t) PySequence_Fast_GET_SIZE(seq);
+    if (n > UINT32_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "too many objects");
+        goto cleanup;
+    }
+    records = PyMem_New(packed_record, n + 1);
+    names = PyMem_New(const char *, n + 1);
+    name_lens = PyMem_New(Py_ssize_t, n + 1);
+    if (!records || !names || !name_lens) {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+    total = sizeof(header) + n * sizeof(*records);
+    for (size_t i = 0; i < n; i++) {
+        if (pack_record(self, PySequence_Fast_GET_ITEM(seq, i), records + i, names + i, name_lens + i) < 0)
+            goto cleanup;
+        total += (size_t) name_lens[i];
+    }
+    data = PyBytes_FromStringAndSize(NULL, (Py_ssize_t) total);
+    if (!data) goto cleanup;
+    memcpy(header.magic, PACKED_MAGIC, sizeof(header.magic));
+    header.version = PACKED_VERSION;
+    header.record_size = (uint16_t) sizeof(packed_record);
+    header.count = (uint32_t) n;
+    p = PyBytes_AS_STRING(data);
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    if (n) memcpy(p, records, n * sizeof(*records));
+    p += n * sizeof(*records);
+    for (size_t i = 0; i < n; i++) {
+        if (!names[i]) continue;
+        memcpy(p, names[i], (size_t) name_lens[i]);
+        p += name_lens[i];
+    }
+    res = PyObject_New(PackedObject, (PyTypeObject *) get_module_state(self)->PackedType);
+    if (res) {
+        res->data = data;
+        data = NULL;
+    }
+
+cleanup:
+    PyMem_Free(records);
+    PyMem_Free(names);
+    PyMem_Free(name_lens);
+    Py_XDECREF(data);
+    Py_DECREF(seq);
+    return (PyObject *) res;
+}
+
+static PyObject *
+unpack_record(PyObject *module, const packed_record *rec, const char *name)
+{
+    module_state *state = get_module_state(module);
+    enum pickle_kind kind = (enum pickle_kind) rec->kind;
+    PyTypeObject *type = (PyTypeObject *) (kind == PICKLE_LOCATION ? state->LocationType : state->ItemType);
+    PyObject *base, *o;
+    base = shared_object(module, kind, rec->type, rec->index);
+    if (!base && PyErr_Occurred()) return NULL;
+    if (base && (rec->flags & PACKED_FROZEN)) {
+        /* unchanged shared object */
+        packed_record shared;
+        const char *shared_name;
+        Py_ssize_t shared_len;
+        if (pack_record(module, base, &shared, &shared_name, &shared_len) < 0) {
+            Py_DECREF(base);
+            return NULL;
+        }
+        if (memcmp(&shared, rec, sizeof(shared)) == 0) return base;
+    }
+    o = new_table_object(type, kind, base);
+    if (!o) goto error;
+    if (!(rec->flags & PACKED_SHARED_NAME) || !base) {
+        PyObject *oname = PyUnicode_DecodeUTF8(name, (Py_ssize_t) rec->name_len, NULL);
+        PyObject **dst = (kind == PICKLE_LOCATION) ? &((LocationObject *) o)->name : &((ItemObject *) o)->name;
+        if (!oname) goto error;
+        Py_XSETREF(*dst, oname);
+    }
+    if (kind == PICKLE_LOCATION) {
+        LocationObject *loc = (LocationObject *) o;
+        loc->type = (enum check_tree_item_type) rec->type;
+        loc->index = (unsigned short) rec->index;
+        loc->difficulty = (char) rec->difficulty;
+        for (size_t i = 0; i < ARRAY_SIZE(loc->requires); i++) {
+            loc->requires[i].pieces = rec->requires[i][0];
+            loc->requires[i].progress = (enum progression) rec->requires[i][1];
+        }
+        for (size_t i = 0; i < ARRAY_SIZE(loc->provides); i++) {
+            loc->provides[i].pieces = rec->provides[i][0];
+            loc->provides[i].progress = (enum progression) rec->provides[i][1];
+        }
+        loc->frozen = (rec->flags & PACKED_FROZEN) ? 1 : 0;
+    } else {
+        ItemObject *item = (ItemObject *) o;
+        item->type = (enum check_tree_item_type) rec->type;
+        item->index = (unsigned short) rec->index;
+        item->progression = (rec->flags & PACKED_PROGRESSION) ? 1 : 0;
+        item->useful = (rec->flags & PACKED_USEFUL) ? 1 : 0;
+        for (size_t i = 0; i < ARRAY_SIZE(item->provides); i++) {
+            item->provides[i].pieces = rec->provides[i][0];
+            item->provides[i].progress = (enum progression) rec->provides[i][1];
+        }
+        item->frozen = (rec->flags & PACKED_FROZEN) ? 1 : 0;
+    }
+    Py_XDECREF(base);
+    return o;
+error:
+    Py_XDECREF(o);
+    Py_XDECREF(base);
+    return NULL;
+}
+
+static PyObject *
+_evermizer_unpack(PyObject *self, PyObject *arg)
+{
+    /* _evermizer.unpack call signature:
+        data: Packed or other bytes-like of pack()
+       returns list of Location and Item */
+    Py_buffer view;
+    packed_header header;
+    PyObject *res = NULL;
+    const char *records, *names;
+    size_t names_len;
+    if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) < 0) return NULL;
+    if ((size_t) view.len < sizeof(header)) goto invalid;
+    memcpy(&header, view.buf, sizeof(header));
+    if (memcmp(header.magic, PACKED_MAGIC, sizeof(header.magic)) != 0 || header.version != PACKED_VERSION)
+        goto invalid;
+    if (header.record_size != sizeof(packed_record)) {
+        PyErr_SetString(PyExc_ValueError, "Packed by a build with different tables");
+        goto cleanup;
+    }
+    if (((size_t) view.len - sizeof(header)) / sizeof(packed_record) < header.count) goto invalid;
+    records = (const char *) view.buf + sizeof(header);
+    names = records + (size_t) header.count * sizeof(packed_record);
+    names_len = (size_t) view.len - sizeof(header) - (size_t) header.count * sizeof(packed_record);
+    res = PyList_New((Py_ssize_t) header.count);
+    if (!res) goto cleanup;
+    for (size_t i = 0; i < header.count; i++) {
+        packed_record rec;
+        PyObject *o;
+        memcpy(&rec, records + i * sizeof(rec), sizeof(rec)); /* buffer may be unaligned */
+        if ((rec.kind != PICKLE_LOCATION && rec.kind != PICKLE_ITEM) || rec.name_len > names_len ||
+                rec.index > 0xffff) {
+            Py_CLEAR(res);
+            goto invalid;
+        }
+        o = unpack_record(self, &rec, names);
+        if (!o) {
+            Py_CLEAR(res);
+            goto cleanup;
+        }
+        PyList_SET_ITEM(res, (Py_ssize_t) i, o);
+        names += rec.name_len;
+        names_len -= rec.name_len;
+    }
+    goto cleanup;
+
+invalid:
+    PyErr_SetString(PyExc_ValueError, "Invalid packed data");
+cleanup:
+    PyBuffer_Release(&view);
+    return res;
+}
+
+/* module */
+static PyMethodDef _evermizer_methods[] = {
+    {"main", (PyCFunction)(void(*)(void))_evermizer_main, METH_VARARGS | METH_KEYWORDS, "Run ROM generation"},
+    {"generate", (PyCFunction)(void(*)(void))_evermizer_generate, METH_VARARGS | METH_KEYWORDS,
+        "Run ROM generation in memory, returns the ROM"},
+    {"generate_many", (PyCFunction)(void(*)(void))_evermizer_generate_many, METH_VARARGS | METH_KEYWORDS,
+        "Run multiple in-memory ROM generations on a thread pool, returns list of ROMs or exceptions"},
+    {"load_rom", _evermizer_load_rom, METH_O,
+        "Load and validate source ROM from a str or PathLike path or from a buffer, for use with main and generate"},
+    {"get_locations", (PyCFunction)(void(*)(void))_evermizer_get_locations, METH_VARARGS | METH_KEYWORDS,
+        "Returns tuple of \"regular\" locations"},
+    {"get_sniff_locations", (PyCFunction)(void(*)(void))_evermizer_get_sniff_locations, METH_VARARGS | METH_KEYWORDS,
+        "Returns tuple of sniff locations"},
+    {"get_items", (PyCFunction)(void(*)(void))_evermizer_get_items, METH_VARARGS | METH_KEYWORDS,
+        "Returns tuple of default items"},
+    {"get_sniff_items", (PyCFunction)(void(*)(void))_evermizer_get_sniff_items, METH_VARARGS | METH_KEYWORDS,
+        "Returns tuple of vanilla sniff items"},
+    {"get_extra_items", (PyCFunction)(void(*)(void))_evermizer_get_extra_items, METH_VARARGS | METH_KEYWORDS,
+        "Returns tuple of other items not placed by default"},
+    {"get_traps", (PyCFunction)(void(*)(void))_evermizer_get_traps, METH_VARARGS | METH_KEYWORDS,
+        "Returns trap items"},
+    {"get_logic", (PyCFunction)(void(*)(void))_evermizer_get_logic, METH_VARARGS | METH_KEYWORDS,
+        "Returns a tuple of real and pseudo locations that provide progression"},
+    {"get_location", _evermizer_get_location, METH_VARARGS, "Returns location by (type, index)"},
+    {"get_item", _evermizer_get_item, METH_VARARGS, "Returns non-sniff item by (type, index)"},
+    {"get_location_by_name", _evermizer_get_location_by_name, METH_O, "Returns location by name"},
+    {"sweep", _evermizer_sweep, METH_O,
+        "Returns reachable locations and final progression counts for the given progression counts"},
+    {"get_columns", _evermizer_get_columns, METH_O,
+        "Returns dict of read-only columns of blank_check_tree, drops or extra_data for use with numpy"},
+    {"pack", _evermizer_pack, METH_O, "Packs a sequence of Location and Item into a buffer for pickling"},
+    {"unpack", _evermizer_unpack, METH_O, "Returns list of Location and Item from a packed buffer"},
+    {"_restore_location", _evermizer_restore_location, METH_VARARGS, NULL},
+    {"_restore_item", _evermizer_restore_item, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}        /* Sentinel */
+};
+
+static int
+_evermizer_exec(PyObject *m)
+{
+    module_state *state = get_module_state(m);
+    bool ok;
+
+    /* interpreters share the GIL, see _evermizer_slots, so the first exec can't race another */
+    if (!evermizer_lock) evermizer_lock = PyThread_allocate_lock();
+    state->cache_lock = PyThread_allocate_lock();
+    if (!evermizer_lock || !state->cache_lock) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    evermizer_lock_enter(true);
+    ok = init_lookup(state) == 0;
+    if (ok && !logic_graph_init(&state->logic)) {
+        PyErr_NoMemory();
+        ok = false;
+    }
+    evermizer_lock_leave();
+    if (!ok) return -1;
+    state->LocationType = PyType_FromModuleAndSpec(m, &Location_spec, NULL);
+    if (!state->LocationType || PyModule_AddType(m, (PyTypeObject *) state->LocationType) < 0) return -1;
+    state->ItemType = PyType_FromModuleAndSpec(m, &Item_spec, NULL);
+    if (!state->ItemType || PyModule_AddType(m, (PyTypeObject *) state->ItemType) < 0) return -1;
+    state->RomHandleType = PyType_FromModuleAndSpec(m, &RomHandle_spec, NULL);
+    if (!state->RomHandleType || PyModule_AddType(m, (PyTypeObject *) state->RomHandleType) < 0) return -1;
+    state->ColumnType = PyType_FromModuleAndSpec(m, &Column_spec, NULL);
+    if (!state->ColumnType || PyModule_AddType(m, (PyTypeObject *) state->ColumnType) < 0) return -1;
+    state->ProgressionStateType = PyType_FromModuleAndSpec(m, &ProgressionState_spec, NULL);
+    if (!state->ProgressionStateType ||
+            PyModule_AddType(m, (PyTypeObject *) state->ProgressionStateType) < 0) return -1;
+    state->ReachabilityType = PyType_FromModuleAndSpec(m, &Reachability_spec, NULL);
+    if (!state->ReachabilityType || PyModule_AddType(m, (PyTypeObject *) state->ReachabilityType) < 0) return -1;
+    state->PackedType = PyType_FromModuleAndSpec(m, &Packed_spec, NULL);
+    if (!state->PackedType || PyModule_AddType(m, (PyTypeObject *) state->PackedType) < 0) return -1;
+    state->GenerateJobType = PyType_FromModuleAndSpec(m, &GenerateJob_spec, NULL);
+    if (!state->GenerateJobType || PyModule_AddType(m, (PyTypeObject *) state->GenerateJobType) < 0) return -1;
 
     /* add required constants/enum values to module */
-    if (PyModule_AddIntConstant(m, "P_NONE", P_NONE) ||
+    if (PyModule_AddIntConstant(m, "P_COUNT", (long) state->logic.num_progressions) ||
+        PyModule_AddIntConstant(m, "TRACEMALLOC_DOMAIN", NATIVE_TRACEMALLOC_DOMAIN) ||
+        PyModule_AddIntConstant(m, "P_NONE", P_NONE) ||
         PyModule_AddIntConstant(m, "P_WEAPON", P_WEAPON) ||
         PyModule_AddIntConstant(m, "P_ALLOW_SEQUENCE_BREAKS", P_ALLOW_SEQUENCE_BREAKS) ||
         PyModule_AddIntConstant(m, "P_ALLOW_OOB", P_ALLOW_OOB) ||
@@ -779,24 +3122,106 @@ PyInit__evermizer(void)
         PyModule_AddIntConstant(m, "CHECK_NPC", CHECK_NPC) ||
         PyModule_AddIntConstant(m, "CHECK_RULE", CHECK_RULE)
     ) {
-        goto const_error;
+        return -1;
     }
 
-    /* initialize global semaphore. we leak this memory */
-    threading = PyImport_ImportModule("threading");
-    if (threading) {
-        semaphore = PyObject_CallMethod(threading, "BoundedSemaphore", NULL);
-        Py_DECREF(threading);
-        if (!semaphore) goto const_error;
-    } else {
-        /* threading not built in */
-        PyErr_Clear();
+    return 0;
+}
+
+static int
+_evermizer_traverse(PyObject *m, visitproc visit, void *arg)
+{
+    module_state *state = get_module_state(m);
+    Py_VISIT(state->LocationType);
+    Py_VISIT(state->ItemType);
+    Py_VISIT(state->RomHandleType);
+    Py_VISIT(state->ColumnType);
+    Py_VISIT(state->ProgressionStateType);
+    Py_VISIT(state->ReachabilityType);
+    Py_VISIT(state->PackedType);
+    Py_VISIT(state->GenerateJobType);
+    for (size_t i = 0; i < CACHED_GETTER_COUNT; i++) Py_VISIT(state->cache[i]);
+    return 0;
+}
+
+static int
+_evermizer_clear(PyObject *m)
+{
+    module_state *state = get_module_state(m);
+    Py_CLEAR(state->LocationType);
+    Py_CLEAR(state->ItemType);
+    Py_CLEAR(state->RomHandleType);
+    Py_CLEAR(state->ColumnType);
+    Py_CLEAR(state->ProgressionStateType);
+    Py_CLEAR(state->ReachabilityType);
+    Py_CLEAR(state->PackedType);
+    Py_CLEAR(state->GenerateJobType);
+    for (size_t i = 0; i < CACHED_GETTER_COUNT; i++) Py_CLEAR(state->cache[i]);
+    return 0;
+}
+
+static void
+_evermizer_free(void *m)
+{
+    module_state *state = get_module_state((PyObject *) m);
+    _evermizer_clear((PyObject *) m);
+    if (state && state->cache_lock) {
+        PyThread_free_lock(state->cache_lock);
+        state->cache_lock = NULL;
+    }
+    if (state) {
+        pos_index_free(&state->location_pos);
+        pos_index_free(&state->item_pos);
+        name_index_free(&state->location_names);
+        logic_graph_free(&state->logic);
     }
+}
+
+static PyModuleDef_Slot _evermizer_slots[] = {
+    {Py_mod_exec, (void *) _evermizer_exec},
+    /* evermizer's globals are only guarded by evermizer_lock, which the first exec allocates under the shared GIL.
+       a per-interpreter GIL or GIL_NOT_USED need main.c audited for its global state first */
+#if defined(Py_mod_multiple_interpreters)
+    {Py_mod_multiple_interpreters, Py_MOD_MULTIPLE_INTERPRETERS_SUPPORTED},
+#endif
+#if defined(Py_mod_gil)
+    {Py_mod_gil, Py_MOD_GIL_USED},
+#endif
+    {0, NULL}
+};
+
+static struct PyModuleDef _evermizer_module = {
+    PyModuleDef_HEAD_INIT,
+    "_evermizer", /* name of module */
+    NULL,         /* module documentation, may be NULL */
+    sizeof(module_state), /* size of per-interpreter state of the module */
+    _evermizer_methods,
+    _evermizer_slots,
+    _evermizer_traverse,
+    _evermizer_clear,
+    _evermizer_free,
+};
 
+PyMODINIT_FUNC
+PyInit__evermizer(void)
+{
+    return PyModuleDef_Init(&_evermizer_module);
+}
+
+#if defined(__CLING__)
+/* cppyy can't run multi-phase init through the import system, see _fallback.py */
+PyObject *
+_evermizer_create_module(const char *name)
+{
+    PyObject *machinery, *spec, *m;
+    machinery = PyImport_ImportModule("importlib.machinery");
+    if (!machinery) return NULL;
+    spec = PyObject_CallMethod(machinery, "ModuleSpec", "(sO)", name, Py_None);
+    Py_DECREF(machinery);
+    if (!spec) return NULL;
+    m = PyModule_FromDefAndSpec(&_evermizer_module, spec);
+    Py_DECREF(spec);
+    if (m && PyModule_ExecDef(m, &_evermizer_module) < 0) Py_CLEAR(m);
     return m;
-const_error:
-    /* FIXME: do we need to decref the types? */
-type_error:
-    Py_XDECREF(m);
-    return NULL;
 }
+#endif
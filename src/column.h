@@ -0,0 +1,100 @@
+#pragma once
+#include <Python.h>
+#include <structmember.h>
+
+/*** _evermizer.Column type ***/
+
+#define COLUMN_MAX_DIM 3
+
+typedef struct {
+    PyObject_HEAD
+    void *data; /* C-contiguous, owned */
+    const char *format; /* struct module format of one item */
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[COLUMN_MAX_DIM];
+    Py_ssize_t strides[COLUMN_MAX_DIM];
+} ColumnObject;
+
+static void
+Column_dealloc(ColumnObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    PyMem_Free(self->data);
+    tp->tp_free((PyObject *) self);
+    Py_DECREF(tp); /* heap type */
+}
+
+static ColumnObject *
+Column_create(PyTypeObject *type, const char *format, Py_ssize_t itemsize, int ndim, const Py_ssize_t *shape)
+{
+    /* allocate a zeroed column of the given shape */
+    ColumnObject *self = PyObject_New(ColumnObject, type);
+    Py_ssize_t len = itemsize;
+    if (!self) return NULL;
+    self->format = format;
+    self->itemsize = itemsize;
+    self->ndim = ndim;
+    for (int i = ndim - 1; i >= 0; i--) {
+        self->shape[i] = shape[i];
+        self->strides[i] = len;
+        len *= shape[i];
+    }
+    self->data = PyMem_Calloc(len ? (size_t) len : 1, 1);
+    if (!self->data) {
+        Py_DECREF(self);
+        return (ColumnObject *) PyErr_NoMemory();
+    }
+    return self;
+}
+
+static int
+Column_getbuffer(ColumnObject *self, Py_buffer *view, int flags)
+{
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "Column is read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    view->buf = self->data;
+    view->obj = (PyObject *) self;
+    Py_INCREF(self);
+    view->len = self->shape[0] * self->strides[0];
+    view->readonly = 1;
+    if (!(flags & PyBUF_ND)) {
+        /* without shape the consumer sees plain bytes, like PyBuffer_FillInfo */
+        view->itemsize = 1;
+        view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+        view->ndim = 1;
+        view->shape = NULL;
+        view->strides = NULL;
+    } else {
+        view->itemsize = self->itemsize;
+        view->format = (flags & PyBUF_FORMAT) ? (char*) self->format : NULL;
+        view->ndim = self->ndim;
+        view->shape = self->shape;
+        view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? self->strides : NULL;
+    }
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+#if !defined(Py_TPFLAGS_DISALLOW_INSTANTIATION)
+#define Py_TPFLAGS_DISALLOW_INSTANTIATION 0
+#endif
+
+static PyType_Slot Column_slots[] = {
+    {Py_tp_doc, (void *) "Read-only column of a logic table, use with memoryview or numpy.asarray"},
+    {Py_tp_dealloc, (void *) Column_dealloc},
+    {Py_bf_getbuffer, (void *) Column_getbuffer},
+    {0, NULL}
+};
+
+static PyType_Spec Column_spec = {
+    .name = "_evermizer.Column",
+    .basicsize = sizeof(ColumnObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    .slots = Column_slots,
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <Python.h>
+
+/*** _evermizer.GenerateJob type ***/
+
+#if defined(Py_BEGIN_CRITICAL_SECTION)
+#define GENERATE_JOB_LOCK(o) Py_BEGIN_CRITICAL_SECTION(o)
+#define GENERATE_JOB_UNLOCK() Py_END_CRITICAL_SECTION()
+#else
+#define GENERATE_JOB_LOCK(o) {
+#define GENERATE_JOB_UNLOCK() }
+#endif
+
+enum generate_job_state {
+    JOB_PREPARED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FINISHED
+};
+
+/* generate() split into steps, so it can be run by an event loop or custom scheduler */
+typedef struct {
+    PyObject_HEAD
+    generate_job job;
+    enum generate_job_state state;
+} GenerateJobObject;
+
+static void
+GenerateJob_dealloc(GenerateJobObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    if (self->state != JOB_FINISHED) {
+        /* result was never collected, drop the captured output */
+        Py_CLEAR(self->job.run.ctx.logger);
+        Py_CLEAR(self->job.run.ctx.stats_dict);
+        generate_job_free(&self->job);
+    }
+    tp->tp_free((PyObject *) self);
+    Py_DECREF(tp); /* heap type */
+}
+
+static PyObject *
+GenerateJob_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    /* same arguments as generate() */
+    module_state *state = (module_state *) PyType_GetModuleState(type);
+    GenerateJobObject *self;
+    if (!state) return NULL;
+    self = (GenerateJobObject *) type->tp_alloc(type, 0);
+    if (!self) return NULL;
+    self->state = JOB_PREPARED;
+    if (generate_job_init(&self->job, state, args, kwds) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *) self;
+}
+
+static PyObject *
+GenerateJob_run(GenerateJobObject *self, PyObject *Py_UNUSED(ignored))
+{
+    /* blocks the calling thread, but not the GIL */
+    bool start;
+    GENERATE_JOB_LOCK(self)
+    start = self->state == JOB_PREPARED;
+    if (start) self->state = JOB_RUNNING;
+    GENERATE_JOB_UNLOCK()
+    if (!start) {
+        PyErr_SetString(PyExc_RuntimeError, "GenerateJob can only run once");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    generate_job_execute(&self->job);
+    Py_END_ALLOW_THREADS
+    GENERATE_JOB_LOCK(self)
+    self->state = JOB_DONE;
+    GENERATE_JOB_UNLOCK()
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+GenerateJob_cancel(GenerateJobObject *self, PyObject *Py_UNUSED(ignored))
+{
+    /* safe to call from any thread while the job runs */
+    ABORT_FLAG_SET(&self->job.run.ctx.aborted);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+GenerateJob_result(GenerateJobObject *self, PyObject *Py_UNUSED(ignored))
+{
+    /* sends captured output to the logger on the calling thread, then returns what generate() would */
+    bool done;
+    PyObject *res;
+    GENERATE_JOB_LOCK(self)
+    done = self->state == JOB_DONE;
+    if (done) self->state = JOB_FINISHED;
+    GENERATE_JOB_UNLOCK()
+    if (!done) {
+        PyErr_SetString(PyExc_RuntimeError, self->state == JOB_FINISHED ? "GenerateJob result was already collected"
+                                                                       : "GenerateJob did not run yet");
+        return NULL;
+    }
+    run_finish(&self->job.run); /* log before raising */
+    res = generate_job_result(&self->job);
+    generate_job_free(&self->job);
+    return res;
+}
+
+static PyObject *
+GenerateJob_get_done(GenerateJobObject *self, void *closure)
+{
+    return PyBool_FromLong(self->state >= JOB_DONE);
+}
+
+static PyMethodDef GenerateJob_methods[] = {
+    {"run", (PyCFunction) GenerateJob_run, METH_NOARGS, "Run generation, releases the GIL"},
+    {"cancel", (PyCFunction) GenerateJob_cancel, METH_NOARGS,
+        "Discard the result. A job that did not start evermizer yet skips it, a running evermizer is not interrupted "
+        "and only fails at its next file access. Can be called from any thread"},
+    {"result", (PyCFunction) GenerateJob_result, METH_NOARGS,
+        "Log captured output and return the result of generate() or raise, once after run"},
+    {NULL}
+};
+
+static PyGetSetDef GenerateJob_getset[] = {
+    {"done", (getter) GenerateJob_get_done, NULL, "run() finished", NULL},
+    {NULL}
+};
+
+static PyType_Slot GenerateJob_slots[] = {
+    {Py_tp_doc, (void *) "GenerateJob(*args, **kwargs) prepares generate(*args, **kwargs) to run() on any thread"},
+    {Py_tp_new, (void *) GenerateJob_new},
+    {Py_tp_dealloc, (void *) GenerateJob_dealloc},
+    {Py_tp_methods, (void *) GenerateJob_methods},
+    {Py_tp_getset, (void *) GenerateJob_getset},
+    {0, NULL}
+};
+
+static PyType_Spec GenerateJob_spec = {
+    .name = "_evermizer.GenerateJob",
+    .basicsize = sizeof(GenerateJobObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = GenerateJob_slots,
+};
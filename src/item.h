@@ -11,14 +11,17 @@ typedef struct {
     char useful;
     enum check_tree_item_type type;
     unsigned short index; 
-    PyObject *provides;
+    char frozen; /* shared, memoized instance */
+    struct progression_provider provides[ITEM_PROVIDES_LEN]; /* inline, P_NONE terminated */
 } ItemObject;
 
 static void
 Item_dealloc(ItemObject *self)
 {
+    PyTypeObject *tp = Py_TYPE(self);
     Py_XDECREF(self->name);
-    Py_TYPE(self)->tp_free((PyObject *) self);
+    tp->tp_free((PyObject *) self);
+    Py_DECREF(tp); /* heap type */
 }
 
 static PyObject *
@@ -37,17 +40,22 @@ Item_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 
     self->progression = 0;
     self->useful = 0;
+    copy_providers(self->provides, ARRAY_SIZE(self->provides), NULL, 0);
 
-    self->provides = PyList_New(0);
-    if (self->provides == NULL) {
-        // FIXME: do we need to decref name?
-        Py_DECREF(self);
-        return NULL;
-    }
-    
     return (PyObject *) self;
 }
 
+static int
+Item_check_mutable(ItemObject *self)
+{
+    /* shared instances can't be changed through setattr or __init__ */
+    if (self->frozen) {
+        PyErr_Format(PyExc_AttributeError, "Item is read-only, use copy=True to get mutable ones");
+        return -1;
+    }
+    return 0;
+}
+
 static int
 Item_init(ItemObject *self, PyObject *args, PyObject *kwds)
 {
@@ -55,6 +63,7 @@ Item_init(ItemObject *self, PyObject *args, PyObject *kwds)
     PyObject *name = NULL;
     bool progression = false;
     
+    if (Item_check_mutable(self) < 0) return -1;
     if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Op", (char**)kwlist, &name, &progression))
         return -1;
     
@@ -68,25 +77,72 @@ Item_init(ItemObject *self, PyObject *args, PyObject *kwds)
     return 0;
 }
 
+static int
+Item_setattro(ItemObject *self, PyObject *name, PyObject *value)
+{
+    if (Item_check_mutable(self) < 0) return -1;
+    return PyObject_GenericSetAttr((PyObject *) self, name, value);
+}
+
+static int
+Item_freeze(ItemObject *self)
+{
+    /* make instance immutable, so it can be shared between callers */
+    self->frozen = 1;
+    return 0;
+}
+
+static PyObject *
+Item_get_provides(ItemObject *self, void *closure)
+{
+    return tuple_from_providers(self->provides, ARRAY_SIZE(self->provides));
+}
+
+static int
+Item_set_provides(ItemObject *self, PyObject *value, void *closure)
+{
+    return providers_from_sequence(self->provides, ARRAY_SIZE(self->provides), value);
+}
+
+/* defined with the module functions, needs the shared objects */
+static PyObject *Item_reduce_ex(PyObject *self, PyObject *protocol);
+
+static PyMethodDef Item_methods[] = {
+    {"__reduce_ex__", (PyCFunction) Item_reduce_ex, METH_O, NULL},
+    {NULL}
+};
+
 static PyMemberDef Item_members[] = {
     {"name", T_OBJECT_EX, offsetof(ItemObject, name), 1, "Item name"},
     {"progression", T_BOOL, offsetof(ItemObject, progression), 1, "Item is a progression item"},
     {"useful", T_BOOL, offsetof(ItemObject, useful), 1, "Item is a useful item"},
     {"type", T_INT, offsetof(ItemObject, type), 1, "Location type of vanilla item"},
     {"index", T_USHORT, offsetof(ItemObject, index), 1, "Nth location of type"},
-    {"provides", T_OBJECT_EX, offsetof(LocationObject, provides), 0, "List of tuples (amount, progression) providers"},
     {NULL}
 };
 
-static PyTypeObject ItemType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "_evermizer.Item",
-    .tp_doc = "",
-    .tp_basicsize = sizeof(ItemObject),
-    .tp_itemsize = 0,
-    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
-    .tp_new = Item_new,
-    .tp_init = (initproc) Item_init,
-    .tp_dealloc = (destructor) Item_dealloc,
-    .tp_members = Item_members,
+static PyGetSetDef Item_getset[] = {
+    {"provides", (getter) Item_get_provides, (setter) Item_set_provides,
+        "Tuple of tuples (amount, progression) providers", NULL},
+    {NULL}
+};
+
+static PyType_Slot Item_slots[] = {
+    {Py_tp_doc, (void *) ""},
+    {Py_tp_new, (void *) Item_new},
+    {Py_tp_init, (void *) Item_init},
+    {Py_tp_dealloc, (void *) Item_dealloc},
+    {Py_tp_methods, (void *) Item_methods},
+    {Py_tp_members, (void *) Item_members},
+    {Py_tp_getset, (void *) Item_getset},
+    {Py_tp_setattro, (void *) Item_setattro},
+    {0, NULL}
+};
+
+static PyType_Spec Item_spec = {
+    .name = "_evermizer.Item",
+    .basicsize = sizeof(ItemObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .slots = Item_slots,
 };
@@ -10,15 +10,18 @@ typedef struct {
     enum check_tree_item_type type;
     unsigned short index;
     char difficulty;
-    PyObject *requires;
-    PyObject *provides;
+    char frozen; /* shared, memoized instance */
+    struct progression_requirement requires[LOCATION_REQUIRES_LEN]; /* inline, P_NONE terminated */
+    struct progression_provider provides[LOCATION_PROVIDES_LEN];
 } LocationObject;
 
 static void
 Location_dealloc(LocationObject *self)
 {
+    PyTypeObject *tp = Py_TYPE(self);
     Py_XDECREF(self->name);
-    Py_TYPE(self)->tp_free((PyObject *) self);
+    tp->tp_free((PyObject *) self);
+    Py_DECREF(tp); /* heap type */
 }
 
 static PyObject *
@@ -34,30 +37,31 @@ Location_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         Py_DECREF(self);
         return NULL;
     }
-    
-    self->requires = PyList_New(0);
-    if (self->requires == NULL) {
-        // FIXME: do we need to decref name?
-        Py_DECREF(self);
-        return NULL;
-    }
-    
-    self->provides = PyList_New(0);
-    if (self->provides == NULL) {
-        // FIXME: do we need to decref name and requires?
-        Py_DECREF(self);
-        return NULL;
-    }
-    
+
+    copy_requirements(self->requires, ARRAY_SIZE(self->requires), NULL, 0);
+    copy_providers(self->provides, ARRAY_SIZE(self->provides), NULL, 0);
+
     return (PyObject *) self;
 }
 
+static int
+Location_check_mutable(LocationObject *self)
+{
+    /* shared instances can't be changed through setattr or __init__ */
+    if (self->frozen) {
+        PyErr_Format(PyExc_AttributeError, "Location is read-only, use copy=True to get mutable ones");
+        return -1;
+    }
+    return 0;
+}
+
 static int
 Location_init(LocationObject *self, PyObject *args, PyObject *kwds)
 {
     static const char *kwlist[] = {"name", NULL};
     PyObject *name = NULL;
     
+    if (Location_check_mutable(self) < 0) return -1;
     if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", (char**)kwlist, &name))
         return -1;
     
@@ -70,25 +74,85 @@ Location_init(LocationObject *self, PyObject *args, PyObject *kwds)
     return 0;
 }
 
+static int
+Location_setattro(LocationObject *self, PyObject *name, PyObject *value)
+{
+    if (Location_check_mutable(self) < 0) return -1;
+    return PyObject_GenericSetAttr((PyObject *) self, name, value);
+}
+
+static int
+Location_freeze(LocationObject *self)
+{
+    /* make instance immutable, so it can be shared between callers */
+    self->frozen = 1;
+    return 0;
+}
+
+static PyObject *
+Location_get_requires(LocationObject *self, void *closure)
+{
+    return tuple_from_requirements(self->requires, ARRAY_SIZE(self->requires));
+}
+
+static int
+Location_set_requires(LocationObject *self, PyObject *value, void *closure)
+{
+    return requirements_from_sequence(self->requires, ARRAY_SIZE(self->requires), value);
+}
+
+static PyObject *
+Location_get_provides(LocationObject *self, void *closure)
+{
+    return tuple_from_providers(self->provides, ARRAY_SIZE(self->provides));
+}
+
+static int
+Location_set_provides(LocationObject *self, PyObject *value, void *closure)
+{
+    return providers_from_sequence(self->provides, ARRAY_SIZE(self->provides), value);
+}
+
+/* defined with the module functions, needs the shared objects */
+static PyObject *Location_reduce_ex(PyObject *self, PyObject *protocol);
+
+static PyMethodDef Location_methods[] = {
+    {"__reduce_ex__", (PyCFunction) Location_reduce_ex, METH_O, NULL},
+    {NULL}
+};
+
 static PyMemberDef Location_members[] = {
     {"name", T_OBJECT_EX, offsetof(LocationObject, name), 0, "Location name"},
     {"type", T_INT, offsetof(LocationObject, type), 1, "Location type of vanilla item"},
     {"index", T_USHORT, offsetof(LocationObject, index), 1, "Nth location of type"},
     {"difficulty", T_BYTE, offsetof(LocationObject, difficulty), 1, "Difficulty 0..2 for bad/hidden checks"},
-    {"requires", T_OBJECT_EX, offsetof(LocationObject, requires), 0, "List of tuples (amount, progression) requirements"},
-    {"provides", T_OBJECT_EX, offsetof(LocationObject, provides), 0, "Lift of tuples (amount, progression) providers"},
     {NULL}
 };
 
-static PyTypeObject LocationType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "_evermizer.Location",
-    .tp_doc = "",
-    .tp_basicsize = sizeof(LocationObject),
-    .tp_itemsize = 0,
-    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
-    .tp_new = Location_new,
-    .tp_init = (initproc) Location_init,
-    .tp_dealloc = (destructor) Location_dealloc,
-    .tp_members = Location_members,
+static PyGetSetDef Location_getset[] = {
+    {"requires", (getter) Location_get_requires, (setter) Location_set_requires,
+        "Tuple of tuples (amount, progression) requirements", NULL},
+    {"provides", (getter) Location_get_provides, (setter) Location_set_provides,
+        "Tuple of tuples (amount, progression) providers", NULL},
+    {NULL}
+};
+
+static PyType_Slot Location_slots[] = {
+    {Py_tp_doc, (void *) ""},
+    {Py_tp_new, (void *) Location_new},
+    {Py_tp_init, (void *) Location_init},
+    {Py_tp_dealloc, (void *) Location_dealloc},
+    {Py_tp_methods, (void *) Location_methods},
+    {Py_tp_members, (void *) Location_members},
+    {Py_tp_getset, (void *) Location_getset},
+    {Py_tp_setattro, (void *) Location_setattro},
+    {0, NULL}
+};
+
+static PyType_Spec Location_spec = {
+    .name = "_evermizer.Location",
+    .basicsize = sizeof(LocationObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .slots = Location_slots,
 };
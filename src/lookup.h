@@ -0,0 +1,201 @@
+#pragma once
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*** O(1) lookup of table entries by (type, index) and by name ***/
+
+/* values stored in the indices are (list << 16 | position) into the memoized getter results */
+#define LOOKUP_VALUE(list, pos) ((uint32_t)(list) << 16 | (uint32_t)(pos))
+#define LOOKUP_LIST(value) ((value) >> 16)
+#define LOOKUP_POS(value) ((value) & 0xffff)
+
+typedef struct {
+    uint32_t key;   /* type << 16 | index */
+    uint32_t value; /* 0 for empty slot, LOOKUP_VALUE + 1 otherwise */
+} pos_slot;
+
+/* open addressing hash table keyed on (type, index) */
+typedef struct {
+    pos_slot *slots;
+    size_t mask;
+} pos_index;
+
+static inline size_t
+pos_hash(uint32_t key, size_t mask)
+{
+    return (size_t)(key * 2654435761u) & mask;
+}
+
+static bool
+pos_index_init(pos_index *idx, size_t count)
+{
+    size_t cap = 16;
+    while (cap < count * 2) cap *= 2;
+    idx->slots = (pos_slot*) PyMem_Calloc(cap, sizeof(pos_slot));
+    idx->mask = cap - 1;
+    return idx->slots != NULL;
+}
+
+static void
+pos_index_free(pos_index *idx)
+{
+    PyMem_Free(idx->slots);
+    idx->slots = NULL;
+}
+
+static void
+pos_index_put(pos_index *idx, int type, unsigned index, uint32_t value)
+{
+    /* first entry for a key wins */
+    uint32_t key = (uint32_t) type << 16 | index;
+    size_t i = pos_hash(key, idx->mask);
+    while (idx->slots[i].value) {
+        if (idx->slots[i].key == key) return;
+        i = (i + 1) & idx->mask;
+    }
+    idx->slots[i].key = key;
+    idx->slots[i].value = value + 1;
+}
+
+static bool
+pos_index_get(const pos_index *idx, int type, unsigned index, uint32_t *value)
+{
+    uint32_t key = (uint32_t) type << 16 | index;
+    size_t i;
+    if (!idx->slots) return false;
+    i = pos_hash(key, idx->mask);
+    while (idx->slots[i].value) {
+        if (idx->slots[i].key == key) {
+            *value = idx->slots[i].value - 1;
+            return true;
+        }
+        i = (i + 1) & idx->mask;
+    }
+    return false;
+}
+
+/* perfect hash (hash and displace) over constant names.
+   h(name, 0) selects the bucket, h(name, disp[bucket]) the slot; no probing on lookup */
+typedef struct {
+    const char **names; /* per slot, NULL if empty */
+    uint32_t *values;
+    uint32_t *disp;
+    size_t num_slots;
+    size_t num_buckets;
+} name_index;
+
+static inline uint32_t
+name_hash(const char *s, size_t len, uint32_t seed)
+{
+    /* FNV-1a */
+    uint32_t h = 2166136261u ^ (seed * 16777619u);
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t) s[i];
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+static void
+name_index_free(name_index *idx)
+{
+    PyMem_Free((void*) idx->names);
+    PyMem_Free(idx->values);
+    PyMem_Free(idx->disp);
+    memset(idx, 0, sizeof(*idx));
+}
+
+static bool
+name_index_try(name_index *idx, const char **names, const size_t *keys, size_t n, uint32_t d, size_t *slots)
+{
+    /* check if displacement d maps all keys of a bucket to distinct free slots */
+    for (size_t k = 0; k < n; k++) {
+        slots[k] = name_hash(names[keys[k]], strlen(names[keys[k]]), d) % idx->num_slots;
+        if (idx->names[slots[k]]) return false;
+        for (size_t j = 0; j < k; j++) {
+            if (slots[j] == slots[k]) return false;
+        }
+    }
+    return true;
+}
+
+static bool
+name_index_init(name_index *idx, const char **names, const uint32_t *values, size_t count)
+{
+    /* called once at module init. duplicate names resolve to the first entry */
+    size_t *order = NULL, *start = NULL, *slots = NULL, *keys = NULL;
+    uint32_t *bucket = NULL;
+    size_t max_size = 0;
+    bool ok = false;
+    memset(idx, 0, sizeof(*idx));
+    idx->num_buckets = count / 4 + 1;
+    idx->num_slots = count + count / 4 + 1;
+    idx->names = (const char**) PyMem_Calloc(idx->num_slots, sizeof(*idx->names));
+    idx->values = (uint32_t*) PyMem_Calloc(idx->num_slots, sizeof(*idx->values));
+    idx->disp = (uint32_t*) PyMem_Calloc(idx->num_buckets, sizeof(*idx->disp));
+    bucket = (uint32_t*) PyMem_Calloc(count + 1, sizeof(*bucket));
+    order = (size_t*) PyMem_Calloc(count + 1, sizeof(*order));
+    start = (size_t*) PyMem_Calloc(idx->num_buckets + 1, sizeof(*start));
+    slots = (size_t*) PyMem_Calloc(count + 1, sizeof(*slots));
+    keys = (size_t*) PyMem_Calloc(count + 1, sizeof(*keys));
+    if (!idx->names || !idx->values || !idx->disp || !bucket || !order || !start || !slots || !keys) goto cleanup;
+
+    /* group keys by bucket, keeping their order */
+    for (size_t i = 0; i < count; i++) {
+        bucket[i] = name_hash(names[i], strlen(names[i]), 0) % idx->num_buckets;
+        start[bucket[i] + 1]++;
+    }
+    for (size_t b = 0; b < idx->num_buckets; b++) {
+        if (start[b + 1] > max_size) max_size = start[b + 1];
+        start[b + 1] += start[b];
+    }
+    memcpy(slots, start, idx->num_buckets * sizeof(*slots));
+    for (size_t i = 0; i < count; i++) order[slots[bucket[i]]++] = i;
+
+    /* place biggest buckets first, searching a displacement for each */
+    for (size_t size = max_size; size > 0; size--) {
+        for (size_t b = 0; b < idx->num_buckets; b++) {
+            size_t n = 0;
+            if (start[b + 1] - start[b] != size) continue;
+            for (size_t k = start[b]; k < start[b + 1]; k++) {
+                bool dup = false;
+                for (size_t j = 0; j < n && !dup; j++) dup = strcmp(names[keys[j]], names[order[k]]) == 0;
+                if (!dup) keys[n++] = order[k];
+            }
+            for (uint32_t d = 1; d < 0x100000 && !idx->disp[b]; d++) {
+                if (name_index_try(idx, names, keys, n, d, slots)) idx->disp[b] = d;
+            }
+            if (!idx->disp[b]) goto cleanup;
+            for (size_t k = 0; k < n; k++) {
+                idx->names[slots[k]] = names[keys[k]];
+                idx->values[slots[k]] = values[keys[k]];
+            }
+        }
+    }
+    ok = true;
+
+cleanup:
+    PyMem_Free(bucket);
+    PyMem_Free(order);
+    PyMem_Free(start);
+    PyMem_Free(slots);
+    PyMem_Free(keys);
+    if (!ok) name_index_free(idx);
+    return ok;
+}
+
+static bool
+name_index_get(const name_index *idx, const char *name, size_t len, uint32_t *value)
+{
+    size_t slot;
+    uint32_t d;
+    if (!idx->names) return false;
+    d = idx->disp[name_hash(name, len, 0) % idx->num_buckets];
+    slot = name_hash(name, len, d) % idx->num_slots;
+    if (!idx->names[slot] || strlen(idx->names[slot]) != len || memcmp(idx->names[slot], name, len) != 0)
+        return false;
+    *value = idx->values[slot];
+    return true;
+}
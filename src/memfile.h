@@ -0,0 +1,321 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** in-memory files to pass ROMs to/from evermizer without touching the disk ***/
+
+/* allocator for owned buffers, can be overridden before including this */
+#if !defined(MEMFILE_MALLOC)
+#define MEMFILE_MALLOC malloc
+#define MEMFILE_REALLOC realloc
+#define MEMFILE_FREE free
+#endif
+
+/* evermizer paths starting with this are served from memory */
+#define MEMFILE_PREFIX ":memory:"
+
+typedef struct {
+    const char *name;     /* path as passed to evermizer, i.e. ":memory:src.sfc" */
+    const uint8_t *rdata; /* read-only contents or NULL for writable file */
+    uint8_t *data;        /* written contents */
+    size_t size;
+    size_t cap;
+    size_t pos;
+    bool owned;           /* data was allocated by us */
+    bool fixed;           /* data is a caller's buffer that can't grow */
+    bool is_open;
+    bool eof;
+    bool error;
+    bool delta;           /* data holds runs that differ from base instead of the contents */
+    const uint8_t *base;  /* contents a delta file is compared against */
+    size_t base_size;
+    size_t runs_size;     /* bytes of data used by runs */
+    size_t last_run;      /* offset of the last run in data */
+} memfile;
+
+/* delta runs are stored as {size_t offset, size_t len, uint8_t bytes[len]}, unaligned.
+   runs closer than this are merged, which is smaller than another run header */
+#define MEMFILE_DELTA_GAP 8
+
+static void
+memfile_init_read(memfile *mf, const char *name, const void *data, size_t size)
+{
+    memset(mf, 0, sizeof(*mf));
+    mf->name = name;
+    mf->rdata = (const uint8_t*) data;
+    mf->size = size;
+}
+
+static void
+memfile_init_write(memfile *mf, const char *name, void *buf, size_t cap)
+{
+    /* buf may be NULL, in which case memory is allocated on first write */
+    memset(mf, 0, sizeof(*mf));
+    mf->name = name;
+    mf->data = (uint8_t*) buf;
+    mf->cap = buf ? cap : 0;
+}
+
+static void
+memfile_init_fixed(memfile *mf, const char *name, void *buf, size_t cap)
+{
+    /* writing past cap fails instead of moving to the heap */
+    memfile_init_write(mf, name, buf, cap);
+    mf->cap = cap;
+    mf->fixed = true;
+}
+
+static void
+memfile_init_delta(memfile *mf, const char *name, const void *base, size_t base_size)
+{
+    /* writable file that only keeps the bytes that differ from base, see memfile_next_run.
+       falls back to storing the full contents if it's not written sequentially */
+    memfile_init_write(mf, name, NULL, 0);
+    mf->owned = true;
+    mf->delta = true;
+    mf->base = (const uint8_t*) base;
+    mf->base_size = base_size;
+}
+
+static void
+memfile_free(memfile *mf)
+{
+    if (mf->owned) MEMFILE_FREE(mf->data);
+    mf->data = NULL;
+    mf->owned = false;
+    mf->size = mf->cap = mf->pos = 0;
+    mf->runs_size = mf->last_run = 0;
+}
+
+static void
+memfile_truncate(memfile *mf)
+{
+    /* opened for writing. a delta file starts over in delta mode */
+    mf->size = 0;
+    if (mf->base) {
+        mf->delta = true;
+        mf->runs_size = mf->last_run = 0;
+    }
+}
+
+static const uint8_t *
+memfile_contents(const memfile *mf)
+{
+    /* not valid for a file in delta mode */
+    return mf->rdata ? mf->rdata : mf->data;
+}
+
+static bool
+memfile_reserve(memfile *mf, size_t size)
+{
+    size_t newcap;
+    uint8_t *p;
+    if (size <= mf->cap) return true;
+    if (mf->fixed) return false;
+    newcap = mf->cap ? mf->cap : 0x10000;
+    while (newcap < size) newcap *= 2;
+    if (mf->owned) {
+        p = (uint8_t*) MEMFILE_REALLOC(mf->data, newcap);
+        if (!p) return false;
+    } else {
+        /* outgrew the provided buffer, continue on heap */
+        p = (uint8_t*) MEMFILE_MALLOC(newcap);
+        if (!p) return false;
+        if (mf->size) memcpy(p, mf->data, mf->size);
+    }
+    mf->data = p;
+    mf->cap = newcap;
+    mf->owned = true;
+    return true;
+}
+
+static bool
+memfile_delta_add(memfile *mf, size_t offset, const uint8_t *p, size_t len)
+{
+    /* append a run of changed bytes, or extend the last run if it's close */
+    size_t run[2];
+    if (mf->runs_size) {
+        memcpy(run, mf->data + mf->last_run, sizeof(run));
+        if (offset >= run[0] + run[1] && offset - (run[0] + run[1]) <= MEMFILE_DELTA_GAP) {
+            size_t gap = offset - (run[0] + run[1]); /* unchanged, so inside base */
+            if (!memfile_reserve(mf, mf->runs_size + gap + len)) return false;
+            memcpy(mf->data + mf->runs_size, mf->base + run[0] + run[1], gap);
+            memcpy(mf->data + mf->runs_size + gap, p, len);
+            mf->runs_size += gap + len;
+            run[1] += gap + len;
+            memcpy(mf->data + mf->last_run, run, sizeof(run));
+            return true;
+        }
+    }
+    if (!memfile_reserve(mf, mf->runs_size + sizeof(run) + len)) return false;
+    run[0] = offset;
+    run[1] = len;
+    mf->last_run = mf->runs_size;
+    memcpy(mf->data + mf->runs_size, run, sizeof(run));
+    memcpy(mf->data + mf->runs_size + sizeof(run), p, len);
+    mf->runs_size += sizeof(run) + len;
+    return true;
+}
+
+static bool
+memfile_delta_append(memfile *mf, const uint8_t *p, size_t len)
+{
+    /* compare appended bytes against base and store the ones that differ */
+    size_t pos = mf->pos, i = 0;
+    while (i < len) {
+        size_t start;
+        while (i + 64 <= len && pos + i + 64 <= mf->base_size && memcmp(p + i, mf->base + pos + i, 64) == 0) i += 64;
+        while (i < len && pos + i < mf->base_size && p[i] == mf->base[pos + i]) i++;
+        start = i;
+        while (i < len && (pos + i >= mf->base_size || p[i] != mf->base[pos + i])) i++;
+        if (i > start && !memfile_delta_add(mf, pos + start, p + start, i - start)) return false;
+    }
+    return true;
+}
+
+static bool
+memfile_delta_flatten(memfile *mf)
+{
+    /* leave delta mode by rebuilding the full contents */
+    size_t cap = mf->size > 0x10000 ? mf->size : 0x10000;
+    size_t common = mf->size < mf->base_size ? mf->size : mf->base_size;
+    uint8_t *p = (uint8_t*) MEMFILE_MALLOC(cap);
+    size_t run[2];
+    if (!p) return false;
+    memcpy(p, mf->base, common);
+    memset(p + common, 0, cap - common);
+    for (size_t i = 0; i < mf->runs_size; i += sizeof(run) + run[1]) {
+        memcpy(run, mf->data + i, sizeof(run));
+        memcpy(p + run[0], mf->data + i + sizeof(run), run[1]);
+    }
+    MEMFILE_FREE(mf->data);
+    mf->data = p;
+    mf->cap = cap;
+    mf->delta = false;
+    mf->runs_size = mf->last_run = 0;
+    return true;
+}
+
+static bool
+memfile_next_run(const memfile *mf, size_t *it, size_t *offset, const uint8_t **p, size_t *len)
+{
+    /* iterate runs of bytes that differ from base in ascending order, *it starts at 0.
+       bytes past the end of base always differ */
+    if (mf->delta) {
+        size_t run[2];
+        if (*it >= mf->runs_size) return false;
+        memcpy(run, mf->data + *it, sizeof(run));
+        *offset = run[0];
+        *len = run[1];
+        *p = mf->data + *it + sizeof(run);
+        *it += sizeof(run) + run[1];
+        return true;
+    } else {
+        size_t pos = *it;
+        size_t common = mf->size < mf->base_size ? mf->size : mf->base_size;
+        while (pos < common && mf->data[pos] == mf->base[pos]) pos++;
+        if (pos >= mf->size) return false;
+        *offset = pos;
+        *p = mf->data + pos;
+        while (pos < mf->size && (pos >= common || mf->data[pos] != mf->base[pos])) pos++;
+        *len = pos - *offset;
+        *it = pos;
+        return true;
+    }
+}
+
+static size_t
+memfile_read(memfile *mf, void *ptr, size_t size, size_t nmemb)
+{
+    const uint8_t *contents;
+    size_t avail = (mf->pos < mf->size) ? mf->size - mf->pos : 0;
+    size_t n;
+    if (!size || !nmemb) return 0;
+    if (mf->delta && !memfile_delta_flatten(mf)) {
+        mf->error = true;
+        return 0;
+    }
+    contents = memfile_contents(mf);
+    n = avail / size;
+    if (n > nmemb) n = nmemb;
+    if (n < nmemb) mf->eof = true;
+    memcpy(ptr, contents + mf->pos, n * size);
+    mf->pos += n * size;
+    return n;
+}
+
+static size_t
+memfile_write(memfile *mf, const void *ptr, size_t size, size_t nmemb)
+{
+    size_t len = size * nmemb;
+    if (mf->rdata || (nmemb && len / nmemb != size)) {
+        mf->error = true;
+        return 0;
+    }
+    if (!len) return nmemb;
+    if (mf->delta && mf->pos == mf->size) {
+        if (!memfile_delta_append(mf, (const uint8_t*) ptr, len)) {
+            mf->error = true;
+            return 0;
+        }
+        mf->pos += len;
+        mf->size = mf->pos;
+        return nmemb;
+    }
+    if ((mf->delta && !memfile_delta_flatten(mf)) || !memfile_reserve(mf, mf->pos + len)) {
+        mf->error = true;
+        return 0;
+    }
+    if (mf->pos > mf->size) memset(mf->data + mf->size, 0, mf->pos - mf->size); /* sparse */
+    memcpy(mf->data + mf->pos, ptr, len);
+    mf->pos += len;
+    if (mf->pos > mf->size) mf->size = mf->pos;
+    return nmemb;
+}
+
+static int
+memfile_seek(memfile *mf, long offset, int whence)
+{
+    long base;
+    if (whence == SEEK_SET) base = 0;
+    else if (whence == SEEK_CUR) base = (long) mf->pos;
+    else if (whence == SEEK_END) base = (long) mf->size;
+    else return -1;
+    if (base + offset < 0) return -1;
+    mf->pos = (size_t)(base + offset);
+    mf->eof = false;
+    return 0;
+}
+
+static int
+memfile_getc(memfile *mf)
+{
+    if (mf->pos >= mf->size) {
+        mf->eof = true;
+        return EOF;
+    }
+    if (mf->delta && !memfile_delta_flatten(mf)) {
+        mf->error = true;
+        return EOF;
+    }
+    return memfile_contents(mf)[mf->pos++];
+}
+
+static char *
+memfile_gets(memfile *mf, char *s, int n)
+{
+    int i = 0;
+    if (n <= 0) return NULL;
+    while (i < n - 1) {
+        int c = memfile_getc(mf);
+        if (c == EOF) break;
+        s[i++] = (char) c;
+        if (c == '\n') break;
+    }
+    if (i == 0) return NULL;
+    s[i] = 0;
+    return s;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <Python.h>
+
+/*** _evermizer.Packed type ***/
+
+/* Location and Item records packed by pack(), pickled as a single buffer */
+typedef struct {
+    PyObject_HEAD
+    PyObject *data; /* bytes */
+} PackedObject;
+
+static void
+Packed_dealloc(PackedObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    Py_XDECREF(self->data);
+    tp->tp_free((PyObject *) self);
+    Py_DECREF(tp); /* heap type */
+}
+
+static int
+Packed_getbuffer(PackedObject *self, Py_buffer *view, int flags)
+{
+    return PyBuffer_FillInfo(view, (PyObject *) self, PyBytes_AS_STRING(self->data),
+                             PyBytes_GET_SIZE(self->data), 1, flags);
+}
+
+static Py_ssize_t
+Packed_length(PackedObject *self)
+{
+    return PyBytes_GET_SIZE(self->data);
+}
+
+static PyObject *
+Packed_reduce_ex(PackedObject *self, PyObject *arg)
+{
+    /* unpickles to the list of objects. protocol 5 can transfer the buffer out-of-band */
+    long protocol = PyLong_AsLong(arg);
+    PyObject *module = PyType_GetModule(Py_TYPE(self));
+    PyObject *unpack, *buf;
+    if (protocol == -1 && PyErr_Occurred()) return NULL;
+    if (!module) return NULL;
+    unpack = PyObject_GetAttrString(module, "unpack");
+    if (!unpack) return NULL;
+    if (protocol >= 5) {
+        buf = PyPickleBuffer_FromObject((PyObject *) self);
+    } else {
+        buf = self->data;
+        Py_INCREF(buf);
+    }
+    if (!buf) {
+        Py_DECREF(unpack);
+        return NULL;
+    }
+    return Py_BuildValue("(N(N))", unpack, buf);
+}
+
+static PyMethodDef Packed_methods[] = {
+    {"__reduce_ex__", (PyCFunction) Packed_reduce_ex, METH_O, NULL},
+    {NULL}
+};
+
+static PyType_Slot Packed_slots[] = {
+    {Py_tp_doc, (void *) "Packed Location and Item records, see pack() and unpack()"},
+    {Py_tp_dealloc, (void *) Packed_dealloc},
+    {Py_tp_methods, (void *) Packed_methods},
+    {Py_bf_getbuffer, (void *) Packed_getbuffer},
+    {Py_sq_length, (void *) Packed_length},
+    {0, NULL}
+};
+
+static PyType_Spec Packed_spec = {
+    .name = "_evermizer.Packed",
+    .basicsize = sizeof(PackedObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    .slots = Packed_slots,
+};
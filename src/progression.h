@@ -0,0 +1,163 @@
+#pragma once
+#include <Python.h>
+#include <stdbool.h>
+
+/*** (amount, progression) pairs stored inline in Location and Item ***/
+
+/* pairs end at the first P_NONE or 0 amount, like in evermizer's tables */
+#define LOCATION_REQUIRES_LEN ARRAY_SIZE(((struct check_tree_item *) 0)->requires)
+#define LOCATION_PROVIDES_LEN ARRAY_SIZE(((struct check_tree_item *) 0)->provides)
+#define ITEM_PROVIDES_LEN (ARRAY_SIZE(((drop_tree_item *) 0)->provides) > ARRAY_SIZE(((extra_item *) 0)->provides) ? \
+                           ARRAY_SIZE(((drop_tree_item *) 0)->provides) : ARRAY_SIZE(((extra_item *) 0)->provides))
+
+static void
+copy_requirements(struct progression_requirement *dst, size_t dst_len,
+                  const struct progression_requirement *src, size_t src_len)
+{
+    size_t i = 0;
+    for (; i < dst_len && i < src_len; i++) {
+        if (src[i].progress == P_NONE || src[i].pieces == 0) break;
+        dst[i] = src[i];
+    }
+    for (; i < dst_len; i++) {
+        dst[i].pieces = 0;
+        dst[i].progress = P_NONE;
+    }
+}
+
+static void
+copy_providers(struct progression_provider *dst, size_t dst_len,
+               const struct progression_provider *src, size_t src_len)
+{
+    size_t i = 0;
+    for (; i < dst_len && i < src_len; i++) {
+        if (src[i].progress == P_NONE || src[i].pieces == 0) break;
+        dst[i] = src[i];
+    }
+    for (; i < dst_len; i++) {
+        dst[i].pieces = 0;
+        dst[i].progress = P_NONE;
+    }
+}
+
+static PyObject *
+tuple_from_requirements(const struct progression_requirement *first, size_t len)
+{
+    size_t n = 0;
+    PyObject *tuple;
+    while (n < len && first[n].progress != P_NONE && first[n].pieces != 0) n++;
+    tuple = PyTuple_New((Py_ssize_t) n);
+    if (tuple == NULL) return NULL;
+    for (size_t i = 0; i < n; i++) {
+        PyObject *pair = Py_BuildValue("ii", first[i].pieces, first[i].progress);
+        if (!pair) {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(tuple, i, pair);
+    }
+    return tuple;
+}
+
+static PyObject *
+tuple_from_providers(const struct progression_provider *first, size_t len)
+{
+    size_t n = 0;
+    PyObject *tuple;
+    while (n < len && first[n].progress != P_NONE && first[n].pieces != 0) n++;
+    tuple = PyTuple_New((Py_ssize_t) n);
+    if (tuple == NULL) return NULL;
+    for (size_t i = 0; i < n; i++) {
+        PyObject *pair = Py_BuildValue("ii", first[i].pieces, first[i].progress);
+        if (!pair) {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(tuple, i, pair);
+    }
+    return tuple;
+}
+
+static int
+requirements_from_sequence(struct progression_requirement *first, size_t len, PyObject *value)
+{
+    /* parse sequence of (amount, progression). nothing is changed on error */
+    struct progression_requirement tmp[LOCATION_REQUIRES_LEN > 0 ? LOCATION_REQUIRES_LEN : 1];
+    PyObject *seq;
+    Py_ssize_t n;
+    if (!value) {
+        PyErr_SetString(PyExc_TypeError, "Cannot delete requires");
+        return -1;
+    }
+    seq = PySequence_Fast(value, "requires must be a sequence of (amount, progression)");
+    if (!seq) return -1;
+    n = PySequence_Fast_GET_SIZE(seq);
+    if ((size_t) n > len || (size_t) n > ARRAY_SIZE(tmp)) {
+        PyErr_Format(PyExc_ValueError, "At most %zu requirements supported", len);
+        Py_DECREF(seq);
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        int amount, progress;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "ii", &amount, &progress)) {
+            Py_DECREF(seq);
+            return -1;
+        }
+        tmp[i].pieces = amount;
+        tmp[i].progress = (enum progression) progress;
+    }
+    Py_DECREF(seq);
+    copy_requirements(first, len, tmp, (size_t) n);
+    return 0;
+}
+
+static int
+providers_from_sequence(struct progression_provider *first, size_t len, PyObject *value)
+{
+    /* parse sequence of (amount, progression). nothing is changed on error */
+    struct progression_provider tmp[ITEM_PROVIDES_LEN > LOCATION_PROVIDES_LEN ? ITEM_PROVIDES_LEN : LOCATION_PROVIDES_LEN];
+    PyObject *seq;
+    Py_ssize_t n;
+    if (!value) {
+        PyErr_SetString(PyExc_TypeError, "Cannot delete provides");
+        return -1;
+    }
+    seq = PySequence_Fast(value, "provides must be a sequence of (amount, progression)");
+    if (!seq) return -1;
+    n = PySequence_Fast_GET_SIZE(seq);
+    if ((size_t) n > len || (size_t) n > ARRAY_SIZE(tmp)) {
+        PyErr_Format(PyExc_ValueError, "At most %zu providers supported", len);
+        Py_DECREF(seq);
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        int amount, progress;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "ii", &amount, &progress)) {
+            Py_DECREF(seq);
+            return -1;
+        }
+        tmp[i].pieces = amount;
+        tmp[i].progress = (enum progression) progress;
+    }
+    Py_DECREF(seq);
+    copy_providers(first, len, tmp, (size_t) n);
+    return 0;
+}
+
+static bool
+same_requirements(const struct progression_requirement *a, const struct progression_requirement *b, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (a[i].pieces != b[i].pieces || a[i].progress != b[i].progress) return false;
+    }
+    return true;
+}
+
+static bool
+same_providers(const struct progression_provider *a, const struct progression_provider *b, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (a[i].pieces != b[i].pieces || a[i].progress != b[i].progress) return false;
+    }
+    return true;
+}
@@ -0,0 +1,310 @@
+#pragma once
+#include <Python.h>
+#include <stdint.h>
+#include <string.h>
+
+/*** _evermizer.ProgressionState type ***/
+
+/* counts per enum progression. size is logic.num_progressions of the module */
+typedef struct {
+    PyObject_VAR_HEAD
+    int32_t counts[1];
+} ProgressionStateObject;
+
+static inline size_t
+ProgressionState_size(Py_ssize_t n)
+{
+    return (size_t) n * sizeof(int32_t);
+}
+
+static inline int32_t
+count_add(int32_t count, int64_t amount)
+{
+    /* counts saturate instead of overflowing */
+    int64_t sum = (int64_t) count + amount;
+    return (int32_t) (sum > INT32_MAX ? INT32_MAX : sum < INT32_MIN ? INT32_MIN : sum);
+}
+
+static PyObject *
+ProgressionState_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"counts", NULL};
+    module_state *state = (module_state *) PyType_GetModuleState(type);
+    PyObject *ocounts = NULL, *seq;
+    ProgressionStateObject *self;
+    Py_ssize_t n;
+    if (!state) return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", (char**)kwlist, &ocounts)) return NULL;
+    n = (Py_ssize_t) state->logic.num_progressions;
+    self = (ProgressionStateObject *) type->tp_alloc(type, n); /* zeroed */
+    if (!self || !ocounts) return (PyObject *) self;
+    seq = PySequence_Fast(ocounts, "counts must be a sequence");
+    if (!seq) goto error;
+    if (PySequence_Fast_GET_SIZE(seq) > n) {
+        PyErr_Format(PyExc_ValueError, "Expected at most %zd counts", n);
+        Py_DECREF(seq);
+        goto error;
+    }
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+        long v = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+        if ((v == -1 && PyErr_Occurred()) || v < INT32_MIN || v > INT32_MAX) {
+            if (!PyErr_Occurred()) PyErr_SetString(PyExc_OverflowError, "count out of range");
+            Py_DECREF(seq);
+            goto error;
+        }
+        self->counts[i] = (int32_t) v;
+    }
+    Py_DECREF(seq);
+    return (PyObject *) self;
+error:
+    Py_DECREF(self);
+    return NULL;
+}
+
+static void
+ProgressionState_dealloc(ProgressionStateObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    tp->tp_free((PyObject *) self);
+    Py_DECREF(tp); /* heap type */
+}
+
+static int
+progress_arg(PyObject *arg, Py_ssize_t *progress)
+{
+    *progress = PyLong_AsSsize_t(arg);
+    if (*progress == -1 && PyErr_Occurred()) return -1;
+    return 0;
+}
+
+static int
+amount_arg(PyObject *const *args, Py_ssize_t nargs, int32_t *amount)
+{
+    long v;
+    *amount = 1;
+    if (nargs < 2) return 0;
+    v = PyLong_AsLong(args[1]);
+    if (v == -1 && PyErr_Occurred()) return -1;
+    if (v < INT32_MIN || v > INT32_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "amount out of range");
+        return -1;
+    }
+    *amount = (int32_t) v;
+    return 0;
+}
+
+static PyObject *
+ProgressionState_has(ProgressionStateObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    /* has(progress, amount=1). unknown progressions count as 0 */
+    Py_ssize_t progress;
+    int32_t amount, count;
+    if (nargs < 1 || nargs > 2) {
+        PyErr_SetString(PyExc_TypeError, "has() takes progress and optional amount");
+        return NULL;
+    }
+    if (progress_arg(args[0], &progress) < 0 || amount_arg(args, nargs, &amount) < 0) return NULL;
+    count = (progress >= 0 && progress < Py_SIZE(self)) ? self->counts[progress] : 0;
+    return PyBool_FromLong(count >= amount);
+}
+
+static PyObject *
+ProgressionState_add(ProgressionStateObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    /* add(progress, amount=1) */
+    Py_ssize_t progress;
+    int32_t amount;
+    if (nargs < 1 || nargs > 2) {
+        PyErr_SetString(PyExc_TypeError, "add() takes progress and optional amount");
+        return NULL;
+    }
+    if (progress_arg(args[0], &progress) < 0 || amount_arg(args, nargs, &amount) < 0) return NULL;
+    if (progress < 0 || progress >= Py_SIZE(self)) {
+        PyErr_Format(PyExc_ValueError, "Invalid progression %zd", progress);
+        return NULL;
+    }
+    self->counts[progress] = count_add(self->counts[progress], amount);
+    Py_RETURN_NONE;
+}
+
+static int
+inline_provides(const struct progression_provider *first, size_t len, Py_ssize_t num_progressions,
+                struct progression_provider **out, Py_ssize_t *n)
+{
+    /* copy the inline array of a Location or Item, no tuples are created */
+    size_t count = count_providers(first, len);
+    *n = 0;
+    *out = PyMem_New(struct progression_provider, count + 1);
+    if (!*out) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if ((Py_ssize_t) first[i].progress >= num_progressions) {
+            PyErr_Format(PyExc_ValueError, "Invalid progression %d", (int) first[i].progress);
+            PyMem_Free(*out);
+            *out = NULL;
+            return -1;
+        }
+        (*out)[i] = first[i];
+    }
+    *n = (Py_ssize_t) count;
+    return 0;
+}
+
+static int
+item_provides(module_state *state, PyObject *item, Py_ssize_t num_progressions,
+              struct progression_provider **out, Py_ssize_t *n)
+{
+    /* parse and validate (amount, progress) of item.provides into a PyMem array */
+    PyObject *provides;
+    PyObject *seq;
+    int res = -1;
+    if (Py_IS_TYPE(item, (PyTypeObject *) state->LocationType)) {
+        LocationObject *loc = (LocationObject *) item;
+        return inline_provides(loc->provides, ARRAY_SIZE(loc->provides), num_progressions, out, n);
+    }
+    if (Py_IS_TYPE(item, (PyTypeObject *) state->ItemType)) {
+        ItemObject *it = (ItemObject *) item;
+        return inline_provides(it->provides, ARRAY_SIZE(it->provides), num_progressions, out, n);
+    }
+    *out = NULL;
+    *n = 0;
+    provides = PyObject_GetAttrString(item, "provides");
+    if (!provides) return -1;
+    seq = PySequence_Fast(provides, "provides must be a sequence");
+    Py_DECREF(provides);
+    if (!seq) return -1;
+    *out = PyMem_New(struct progression_provider, (size_t) PySequence_Fast_GET_SIZE(seq) + 1);
+    if (!*out) {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+        int amount, progress;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "ii", &amount, &progress)) goto cleanup;
+        if (progress < 0 || progress >= num_progressions) {
+            PyErr_Format(PyExc_ValueError, "Invalid progression %d", progress);
+            goto cleanup;
+        }
+        (*out)[i].pieces = amount;
+        (*out)[i].progress = (enum progression) progress;
+    }
+    *n = PySequence_Fast_GET_SIZE(seq);
+    res = 0;
+cleanup:
+    Py_DECREF(seq);
+    if (res < 0) {
+        PyMem_Free(*out);
+        *out = NULL;
+    }
+    return res;
+}
+
+static int
+ProgressionState_apply(ProgressionStateObject *self, PyObject *item, int sign)
+{
+    /* add or subtract (amount, progress) of item.provides */
+    struct progression_provider *provides;
+    Py_ssize_t n;
+    if (item_provides((module_state *) PyType_GetModuleState(Py_TYPE(self)), item, Py_SIZE(self), &provides, &n) < 0)
+        return -1;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        self->counts[provides[i].progress] = count_add(self->counts[provides[i].progress],
+                                                       (int64_t) sign * provides[i].pieces);
+    }
+    PyMem_Free(provides);
+    return 0;
+}
+
+static PyObject *
+ProgressionState_collect(ProgressionStateObject *self, PyObject *item)
+{
+    if (ProgressionState_apply(self, item, 1) < 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+ProgressionState_remove(ProgressionStateObject *self, PyObject *item)
+{
+    if (ProgressionState_apply(self, item, -1) < 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+ProgressionState_copy(ProgressionStateObject *self, PyObject *Py_UNUSED(ignored))
+{
+    ProgressionStateObject *copy = (ProgressionStateObject *) Py_TYPE(self)->tp_alloc(Py_TYPE(self), Py_SIZE(self));
+    if (copy) memcpy(copy->counts, self->counts, ProgressionState_size(Py_SIZE(self)));
+    return (PyObject *) copy;
+}
+
+static Py_ssize_t
+ProgressionState_length(ProgressionStateObject *self)
+{
+    return Py_SIZE(self);
+}
+
+static PyObject *
+ProgressionState_item(ProgressionStateObject *self, Py_ssize_t i)
+{
+    if (i < 0 || i >= Py_SIZE(self)) {
+        PyErr_SetString(PyExc_IndexError, "progression out of range");
+        return NULL;
+    }
+    return PyLong_FromLong(self->counts[i]);
+}
+
+static PyObject *
+ProgressionState_richcompare(ProgressionStateObject *self, PyObject *other, int op)
+{
+    bool equal;
+    if ((op != Py_EQ && op != Py_NE) || Py_TYPE(other) != Py_TYPE(self)) Py_RETURN_NOTIMPLEMENTED;
+    equal = Py_SIZE(self) == Py_SIZE(other) &&
+            memcmp(self->counts, ((ProgressionStateObject *) other)->counts, ProgressionState_size(Py_SIZE(self))) == 0;
+    return PyBool_FromLong((op == Py_EQ) == equal);
+}
+
+static PyObject *
+ProgressionState_repr(ProgressionStateObject *self)
+{
+    PyObject *list = PySequence_List((PyObject *) self);
+    PyObject *res;
+    if (!list) return NULL;
+    res = PyUnicode_FromFormat("ProgressionState(%R)", list);
+    Py_DECREF(list);
+    return res;
+}
+
+static PyMethodDef ProgressionState_methods[] = {
+    {"has", (PyCFunction)(void(*)(void)) ProgressionState_has, METH_FASTCALL,
+        "has(progress, amount=1) -> True if at least amount of progress was collected"},
+    {"add", (PyCFunction)(void(*)(void)) ProgressionState_add, METH_FASTCALL,
+        "add(progress, amount=1), amount may be negative"},
+    {"collect", (PyCFunction) ProgressionState_collect, METH_O, "Add provides of an Item or Location"},
+    {"remove", (PyCFunction) ProgressionState_remove, METH_O, "Subtract provides of an Item or Location"},
+    {"copy", (PyCFunction) ProgressionState_copy, METH_NOARGS, "Returns a copy of the state"},
+    {"__copy__", (PyCFunction) ProgressionState_copy, METH_NOARGS, NULL},
+    {NULL}
+};
+
+static PyType_Slot ProgressionState_slots[] = {
+    {Py_tp_doc, (void *) "Collected amount per progression, indexed by P_* values"},
+    {Py_tp_new, (void *) ProgressionState_new},
+    {Py_tp_dealloc, (void *) ProgressionState_dealloc},
+    {Py_tp_methods, (void *) ProgressionState_methods},
+    {Py_tp_hash, (void *) PyObject_HashNotImplemented}, /* mutable */
+    {Py_tp_richcompare, (void *) ProgressionState_richcompare},
+    {Py_tp_repr, (void *) ProgressionState_repr},
+    {Py_sq_length, (void *) ProgressionState_length},
+    {Py_sq_item, (void *) ProgressionState_item},
+    {0, NULL}
+};
+
+static PyType_Spec ProgressionState_spec = {
+    .name = "_evermizer.ProgressionState",
+    .basicsize = offsetof(ProgressionStateObject, counts),
+    .itemsize = sizeof(int32_t),
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = ProgressionState_slots,
+};
@@ -0,0 +1,277 @@
+#pragma once
+#include <Python.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*** _evermizer.Reachability type ***/
+
+#if defined(Py_BEGIN_CRITICAL_SECTION)
+#define REACHABILITY_LOCK(o) Py_BEGIN_CRITICAL_SECTION(o)
+#define REACHABILITY_UNLOCK() Py_END_CRITICAL_SECTION()
+#else
+#define REACHABILITY_LOCK(o) {
+#define REACHABILITY_UNLOCK() }
+#endif
+
+/* reachable checks of logic_graph for the collected progression, updated incrementally */
+typedef struct {
+    PyObject_HEAD
+    long *counts;  /* collected + provided by reached checks, per progression */
+    bool *reached; /* per check */
+    logic_work work;
+} ReachabilityObject;
+
+static inline module_state *
+Reachability_state(ReachabilityObject *self)
+{
+    return (module_state *) PyType_GetModuleState(Py_TYPE(self));
+}
+
+static void
+Reachability_dealloc(ReachabilityObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    PyMem_Free(self->counts);
+    PyMem_Free(self->reached);
+    logic_work_free(&self->work);
+    tp->tp_free((PyObject *) self);
+    Py_DECREF(tp); /* heap type */
+}
+
+static ReachabilityObject *
+Reachability_alloc(PyTypeObject *type, const logic_graph *g)
+{
+    ReachabilityObject *self = (ReachabilityObject *) type->tp_alloc(type, 0);
+    if (!self) return NULL;
+    self->counts = PyMem_New(long, g->num_progressions);
+    self->reached = PyMem_New(bool, g->num_checks + 1);
+    if (!self->counts || !self->reached || !logic_work_init(&self->work, g)) {
+        Py_DECREF(self);
+        return (ReachabilityObject *) PyErr_NoMemory();
+    }
+    memset(self->counts, 0, g->num_progressions * sizeof(*self->counts));
+    memset(self->reached, 0, (g->num_checks + 1) * sizeof(*self->reached));
+    return self;
+}
+
+static PyObject *
+Reachability_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"counts", NULL};
+    module_state *state = (module_state *) PyType_GetModuleState(type);
+    const logic_graph *g;
+    PyObject *ocounts = NULL, *progress;
+    ReachabilityObject *self;
+    if (!state) return NULL;
+    g = &state->logic;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", (char**)kwlist, &ocounts)) return NULL;
+    /* parse counts through ProgressionState */
+    if (ocounts && Py_IS_TYPE(ocounts, (PyTypeObject *) state->ProgressionStateType)) {
+        progress = ocounts;
+        Py_INCREF(progress);
+    } else {
+        progress = ocounts ? PyObject_CallOneArg(state->ProgressionStateType, ocounts)
+                           : PyObject_CallNoArgs(state->ProgressionStateType);
+        if (!progress) return NULL;
+    }
+    self = Reachability_alloc(type, g);
+    if (self) {
+        for (Py_ssize_t i = 0; i < Py_SIZE(progress); i++)
+            self->counts[i] = ((ProgressionStateObject *) progress)->counts[i];
+        for (size_t i = 0; i < g->num_checks; i++) logic_work_push(&self->work, g, (uint32_t) i);
+        logic_propagate(&self->work, g, self->counts, self->reached);
+    }
+    Py_DECREF(progress);
+    return (PyObject *) self;
+}
+
+static PyObject *
+Reachability_locations(ReachabilityObject *self, const uint32_t *checks, size_t n, bool reached)
+{
+    /* list of (type, index) of the real locations among checks with the given reached state */
+    module_state *state = Reachability_state(self);
+    PyObject *list = PyList_New(0);
+    if (!list) return NULL;
+    for (size_t k = 0; k < n; k++) {
+        const struct check_tree_item *check = state->logic.checks + checks[k];
+        uint32_t pos;
+        PyObject *id;
+        if (self->reached[checks[k]] != reached) continue;
+        if (!pos_index_get(&state->location_pos, check->type, check->index, &pos)) continue;
+        id = Py_BuildValue("(ii)", (int) check->type, (int) check->index);
+        if (!id || PyList_Append(list, id) < 0) {
+            Py_XDECREF(id);
+            Py_DECREF(list);
+            return NULL;
+        }
+        Py_DECREF(id);
+    }
+    return list;
+}
+
+static PyObject *
+Reachability_change(ReachabilityObject *self, const struct progression_provider *provides, Py_ssize_t n, int sign)
+{
+    /* apply collected or removed progression. returns newly reachable or lost locations */
+    const logic_graph *g = &Reachability_state(self)->logic;
+    size_t lowered[16];
+    size_t *progress = ((size_t) n <= ARRAY_SIZE(lowered)) ? lowered : PyMem_New(size_t, (size_t) n);
+    PyObject *res;
+    if (!progress) return PyErr_NoMemory();
+    REACHABILITY_LOCK(self)
+    if (sign > 0) {
+        for (Py_ssize_t i = 0; i < n; i++) {
+            self->counts[provides[i].progress] += provides[i].pieces;
+            logic_work_wake(&self->work, g, (size_t) provides[i].progress, self->reached);
+        }
+        logic_propagate(&self->work, g, self->counts, self->reached);
+        res = Reachability_locations(self, self->work.changed, self->work.num_changed, true);
+    } else {
+        for (Py_ssize_t i = 0; i < n; i++) {
+            self->counts[provides[i].progress] -= provides[i].pieces;
+            progress[i] = (size_t) provides[i].progress;
+        }
+        logic_retract(&self->work, g, self->counts, self->reached, progress, (size_t) n);
+        res = Reachability_locations(self, self->work.deleted, self->work.num_deleted, false);
+    }
+    REACHABILITY_UNLOCK()
+    if (progress != lowered) PyMem_Free(progress);
+    return res;
+}
+
+static PyObject *
+Reachability_collect(ReachabilityObject *self, PyObject *item)
+{
+    struct progression_provider *provides;
+    Py_ssize_t n;
+    PyObject *res;
+    module_state *state = Reachability_state(self);
+    if (item_provides(state, item, (Py_ssize_t) state->logic.num_progressions, &provides, &n) < 0)
+        return NULL;
+    res = Reachability_change(self, provides, n, 1);
+    PyMem_Free(provides);
+    return res;
+}
+
+static PyObject *
+Reachability_remove(ReachabilityObject *self, PyObject *item)
+{
+    struct progression_provider *provides;
+    Py_ssize_t n;
+    PyObject *res;
+    module_state *state = Reachability_state(self);
+    if (item_provides(state, item, (Py_ssize_t) state->logic.num_progressions, &provides, &n) < 0)
+        return NULL;
+    res = Reachability_change(self, provides, n, -1);
+    PyMem_Free(provides);
+    return res;
+}
+
+static PyObject *
+Reachability_add(ReachabilityObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    /* add(progress, amount=1). negative amounts remove */
+    struct progression_provider provide;
+    Py_ssize_t progress;
+    int32_t amount;
+    if (nargs < 1 || nargs > 2) {
+        PyErr_SetString(PyExc_TypeError, "add() takes progress and optional amount");
+        return NULL;
+    }
+    if (progress_arg(args[0], &progress) < 0 || amount_arg(args, nargs, &amount) < 0) return NULL;
+    if (progress < 0 || progress >= (Py_ssize_t) Reachability_state(self)->logic.num_progressions) {
+        PyErr_Format(PyExc_ValueError, "Invalid progression %zd", progress);
+        return NULL;
+    }
+    provide.pieces = amount < 0 ? -amount : amount;
+    provide.progress = (enum progression) progress;
+    return Reachability_change(self, &provide, amount ? 1 : 0, amount < 0 ? -1 : 1);
+}
+
+static PyObject *
+Reachability_is_reachable(ReachabilityObject *self, PyObject *args)
+{
+    int type;
+    unsigned short index;
+    uint32_t i;
+    if (!PyArg_ParseTuple(args, "iH", &type, &index)) return NULL;
+    if (!pos_index_get(&Reachability_state(self)->logic.check_pos, type, index, &i)) Py_RETURN_FALSE;
+    return PyBool_FromLong(self->reached[i]);
+}
+
+static PyObject *
+Reachability_copy(ReachabilityObject *self, PyObject *Py_UNUSED(ignored))
+{
+    const logic_graph *g = &Reachability_state(self)->logic;
+    ReachabilityObject *copy = Reachability_alloc(Py_TYPE(self), g);
+    if (!copy) return NULL;
+    REACHABILITY_LOCK(self)
+    memcpy(copy->counts, self->counts, g->num_progressions * sizeof(*self->counts));
+    memcpy(copy->reached, self->reached, g->num_checks * sizeof(*self->reached));
+    REACHABILITY_UNLOCK()
+    return (PyObject *) copy;
+}
+
+static PyObject *
+Reachability_get_reachable(ReachabilityObject *self, void *closure)
+{
+    /* all reachable locations. checks are listed in order of blank_check_tree */
+    const logic_graph *g = &Reachability_state(self)->logic;
+    uint32_t *all = PyMem_New(uint32_t, g->num_checks + 1);
+    PyObject *res;
+    if (!all) return PyErr_NoMemory();
+    for (size_t i = 0; i < g->num_checks; i++) all[i] = (uint32_t) i;
+    res = Reachability_locations(self, all, g->num_checks, true);
+    PyMem_Free(all);
+    return res;
+}
+
+static PyObject *
+Reachability_get_state(ReachabilityObject *self, void *closure)
+{
+    /* counts including what reached pseudo locations provide */
+    module_state *state = Reachability_state(self);
+    ProgressionStateObject *res = (ProgressionStateObject *) PyObject_CallNoArgs(state->ProgressionStateType);
+    if (!res) return NULL;
+    for (Py_ssize_t i = 0; i < Py_SIZE(res); i++) {
+        long v = self->counts[i];
+        res->counts[i] = (int32_t) (v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : v);
+    }
+    return (PyObject *) res;
+}
+
+static PyMethodDef Reachability_methods[] = {
+    {"collect", (PyCFunction) Reachability_collect, METH_O,
+        "Add provides of an Item or Location, returns list of newly reachable (type, index)"},
+    {"remove", (PyCFunction) Reachability_remove, METH_O,
+        "Subtract provides of an Item or Location, returns list of no longer reachable (type, index)"},
+    {"add", (PyCFunction)(void(*)(void)) Reachability_add, METH_FASTCALL,
+        "add(progress, amount=1), returns newly reachable or, for negative amount, lost (type, index)"},
+    {"is_reachable", (PyCFunction) Reachability_is_reachable, METH_VARARGS, "is_reachable(type, index) -> bool"},
+    {"copy", (PyCFunction) Reachability_copy, METH_NOARGS, "Returns a copy"},
+    {"__copy__", (PyCFunction) Reachability_copy, METH_NOARGS, NULL},
+    {NULL}
+};
+
+static PyGetSetDef Reachability_getset[] = {
+    {"reachable", (getter) Reachability_get_reachable, NULL, "List of reachable (type, index)", NULL},
+    {"state", (getter) Reachability_get_state, NULL, "ProgressionState including pseudo location progress", NULL},
+    {NULL}
+};
+
+static PyType_Slot Reachability_slots[] = {
+    {Py_tp_doc, (void *) "Reachable locations for collected progression, updated incrementally"},
+    {Py_tp_new, (void *) Reachability_new},
+    {Py_tp_dealloc, (void *) Reachability_dealloc},
+    {Py_tp_methods, (void *) Reachability_methods},
+    {Py_tp_getset, (void *) Reachability_getset},
+    {0, NULL}
+};
+
+static PyType_Spec Reachability_spec = {
+    .name = "_evermizer.Reachability",
+    .basicsize = sizeof(ReachabilityObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = Reachability_slots,
+};
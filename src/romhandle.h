@@ -0,0 +1,251 @@
+#pragma once
+#include <Python.h>
+#include <structmember.h>
+#include <stdbool.h>
+#include <stdint.h>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ROMHANDLE_MMAP
+#endif
+
+/*** _evermizer.RomHandle type ***/
+
+#define ROM_COPIER_HEADER_SIZE 0x200
+#define ROM_SNES_HEADER 0xFFC0 /* HiROM */
+#define ROM_TITLE "SECRET OF EVERMORE"
+#define ROM_MAX_SIZE 0x800000
+
+static size_t
+rom_copier_header_size(size_t size)
+{
+    /* a copier header makes the size 0x200 more than a multiple of 32 KiB */
+    return (size % 0x8000) == ROM_COPIER_HEADER_SIZE ? ROM_COPIER_HEADER_SIZE : 0;
+}
+
+enum rom_storage {
+    ROM_STORAGE_HEAP,
+    ROM_STORAGE_MAPPED,
+    ROM_STORAGE_OBJECT,
+};
+
+typedef struct {
+    PyObject_HEAD
+    const uint8_t *data; /* ROM without copier header */
+    size_t size;
+    const uint8_t *base; /* start of loaded memory */
+    size_t base_size;
+    enum rom_storage storage;
+    PyObject *owner; /* for ROM_STORAGE_OBJECT */
+    char headered;
+    unsigned short checksum;
+} RomHandleObject;
+
+static void
+RomHandle_dealloc(RomHandleObject *self)
+{
+    PyTypeObject *tp = Py_TYPE(self);
+    if (self->base) {
+        if (self->storage == ROM_STORAGE_HEAP) {
+            PyMem_RawFree((void*) self->base);
+        } else if (self->storage == ROM_STORAGE_MAPPED) {
+#if defined(_WIN32)
+            UnmapViewOfFile((LPCVOID) self->base);
+#elif defined(ROMHANDLE_MMAP)
+            munmap((void*) self->base, self->base_size);
+#endif
+        }
+    }
+    Py_XDECREF(self->owner);
+    tp->tp_free((PyObject *) self);
+    Py_DECREF(tp); /* heap type */
+}
+
+static unsigned short
+rom_checksum(const uint8_t *data, size_t size)
+{
+    /* sum of all bytes, non-power-of-2 remainder is mirrored up to the next power of 2 */
+    size_t base = 1;
+    uint32_t sum = 0, rest = 0;
+    while (base * 2 <= size) base *= 2;
+    for (size_t i = 0; i < base; i++) sum += data[i];
+    for (size_t i = base; i < size; i++) rest += data[i];
+    if (size > base) sum += rest * (uint32_t)(base / (size - base));
+    return (unsigned short) sum;
+}
+
+static int
+RomHandle_validate(RomHandleObject *self)
+{
+    /* detect copier header, then check size, title and checksum of the ROM */
+    const uint8_t *hdr;
+    unsigned short checksum, complement;
+    self->headered = rom_copier_header_size(self->base_size) != 0;
+    self->data = self->base + (self->headered ? ROM_COPIER_HEADER_SIZE : 0);
+    self->size = self->base_size - (self->headered ? ROM_COPIER_HEADER_SIZE : 0);
+    if (self->size % 0x8000 || self->size <= ROM_SNES_HEADER + 0x40 || self->size > ROM_MAX_SIZE) {
+        PyErr_Format(PyExc_ValueError, "Invalid ROM size %zu", self->base_size);
+        return -1;
+    }
+    hdr = self->data + ROM_SNES_HEADER;
+    if (memcmp(hdr, ROM_TITLE, sizeof(ROM_TITLE) - 1) != 0) {
+        PyErr_SetString(PyExc_ValueError, "Not a Secret of Evermore ROM");
+        return -1;
+    }
+    complement = (unsigned short)(hdr[0x1c] | (hdr[0x1d] << 8));
+    checksum = (unsigned short)(hdr[0x1e] | (hdr[0x1f] << 8));
+    if ((checksum ^ complement) != 0xffff || rom_checksum(self->data, self->size) != checksum) {
+        PyErr_SetString(PyExc_ValueError, "Bad ROM checksum");
+        return -1;
+    }
+    self->checksum = checksum;
+    return 0;
+}
+
+static int
+RomHandle_load_file(RomHandleObject *self, const char *path)
+{
+    /* map the file read-only, so forked processes share the pages */
+#if defined(_WIN32)
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    const void *view = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart <= ROM_MAX_SIZE + ROM_COPIER_HEADER_SIZE) {
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+                view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+    }
+    Py_END_ALLOW_THREADS
+    if (!view) {
+        PyErr_SetFromWindowsErrWithFilename(0, path);
+        return -1;
+    }
+    self->base = (const uint8_t*) view;
+    self->base_size = (size_t) size.QuadPart;
+    self->storage = ROM_STORAGE_MAPPED;
+    return 0;
+#elif defined(ROMHANDLE_MMAP)
+    int fd;
+    struct stat st;
+    void *p = MAP_FAILED;
+    Py_BEGIN_ALLOW_THREADS
+    fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        if (fstat(fd, &st) == 0) {
+            if (st.st_size > 0 && st.st_size <= ROM_MAX_SIZE + ROM_COPIER_HEADER_SIZE)
+                p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            else
+                errno = EINVAL;
+        }
+        close(fd);
+    }
+    Py_END_ALLOW_THREADS
+    if (p == MAP_FAILED) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        return -1;
+    }
+    self->base = (const uint8_t*) p;
+    self->base_size = (size_t) st.st_size;
+    self->storage = ROM_STORAGE_MAPPED;
+    return 0;
+#else
+    /* no mmap, read into memory */
+    FILE *f = fopen(path, "rb");
+    long size;
+    uint8_t *buf = NULL;
+    if (!f) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        return -1;
+    }
+    fseek(f, 0L, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0L, SEEK_SET);
+    if (size > 0 && size <= ROM_MAX_SIZE + ROM_COPIER_HEADER_SIZE) buf = (uint8_t*) PyMem_RawMalloc((size_t) size);
+    if (!buf || fread(buf, (size_t) size, 1, f) != 1) {
+        fclose(f);
+        PyMem_RawFree(buf);
+        PyErr_Format(PyExc_OSError, "Could not read %s", path);
+        return -1;
+    }
+    fclose(f);
+    self->base = buf;
+    self->base_size = (size_t) size;
+    self->storage = ROM_STORAGE_HEAP;
+    return 0;
+#endif
+}
+
+static int
+RomHandle_load_buffer(RomHandleObject *self, PyObject *obj)
+{
+    /* bytes are immutable, so they can be used as is. anything else gets copied */
+    Py_buffer view;
+    if (PyBytes_Check(obj)) {
+        Py_INCREF(obj);
+        self->owner = obj;
+        self->base = (const uint8_t*) PyBytes_AS_STRING(obj);
+        self->base_size = (size_t) PyBytes_GET_SIZE(obj);
+        self->storage = ROM_STORAGE_OBJECT;
+        return 0;
+    }
+    if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) < 0) return -1;
+    if (view.len > 0 && view.len <= ROM_MAX_SIZE + ROM_COPIER_HEADER_SIZE) {
+        uint8_t *buf = (uint8_t*) PyMem_RawMalloc((size_t) view.len);
+        if (buf) {
+            memcpy(buf, view.buf, (size_t) view.len);
+            self->base = buf;
+            self->base_size = (size_t) view.len;
+            self->storage = ROM_STORAGE_HEAP;
+        } else {
+            PyErr_NoMemory();
+        }
+    } else {
+        PyErr_Format(PyExc_ValueError, "Invalid ROM size %zd", view.len);
+    }
+    PyBuffer_Release(&view);
+    return self->base ? 0 : -1;
+}
+
+static int
+RomHandle_getbuffer(RomHandleObject *self, Py_buffer *view, int flags)
+{
+    return PyBuffer_FillInfo(view, (PyObject *) self, (void*) self->data, (Py_ssize_t) self->size, 1, flags);
+}
+
+static PyMemberDef RomHandle_members[] = {
+    {"size", T_PYSSIZET, offsetof(RomHandleObject, size), 1, "ROM size without copier header"},
+    {"headered", T_BOOL, offsetof(RomHandleObject, headered), 1, "Source had a copier header"},
+    {"checksum", T_USHORT, offsetof(RomHandleObject, checksum), 1, "Checksum from ROM header"},
+    {NULL}
+};
+
+#if !defined(Py_TPFLAGS_DISALLOW_INSTANTIATION)
+#define Py_TPFLAGS_DISALLOW_INSTANTIATION 0
+#endif
+
+static PyType_Slot RomHandle_slots[] = {
+    {Py_tp_doc, (void *) "Validated, read-only source ROM. Create through load_rom()"},
+    {Py_tp_dealloc, (void *) RomHandle_dealloc},
+    {Py_tp_members, (void *) RomHandle_members},
+    {Py_bf_getbuffer, (void *) RomHandle_getbuffer},
+    {0, NULL}
+};
+
+static PyType_Spec RomHandle_spec = {
+    .name = "_evermizer.RomHandle",
+    .basicsize = sizeof(RomHandleObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    .slots = RomHandle_slots,
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <Python.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* USDT probes at phase boundaries, if systemtap's header is available. define EVERMIZER_NO_SDT to disable */
+#if defined(__has_include) && !defined(EVERMIZER_NO_SDT)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define EVERMIZER_SDT
+#endif
+#endif
+
+/*** per-phase timing and counters of a generation run ***/
+
+enum run_phase {
+    PHASE_PREPARE,  /* converting arguments, with the GIL */
+    PHASE_PARSE,    /* evermizer's argument parsing up to opening the source ROM */
+    PHASE_LOAD,     /* reading the source ROM */
+    PHASE_GENERATE, /* patching and randomizing, up to opening the output */
+    PHASE_WRITE,    /* writing the output ROM */
+    PHASE_FINISH,   /* rest of evermizer's main, i.e. spoiler log */
+    PHASE_PATCH,    /* building an IPS or BPS from the output */
+    PHASE_LOG,      /* sending captured output to the logger, with the GIL */
+    PHASE_COUNT,
+    PHASE_NONE = PHASE_COUNT
+};
+
+static const char *const run_phase_names[PHASE_COUNT] = {
+    "prepare", "parse", "load", "generate", "write", "finish", "patch", "log"
+};
+
+typedef struct {
+    enum run_phase phase; /* current phase or PHASE_NONE */
+    uint64_t start_wall, start_cpu; /* ns */
+    uint64_t wall[PHASE_COUNT], cpu[PHASE_COUNT]; /* ns */
+    uint64_t bytes_read;    /* from source ROM */
+    uint64_t bytes_written; /* to output ROM */
+    size_t stdout_lines;    /* printed lines, also if not logged */
+    size_t stderr_lines;
+    int64_t native_bytes;   /* allocated by evermizer and not freed yet */
+    int64_t native_peak;
+} run_stats;
+
+static void
+stats_init(run_stats *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->phase = PHASE_NONE;
+}
+
+static uint64_t
+stats_wall_ns(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t) count.QuadPart / (uint64_t) freq.QuadPart * 1000000000u +
+           (uint64_t) count.QuadPart % (uint64_t) freq.QuadPart * 1000000000u / (uint64_t) freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static uint64_t
+stats_cpu_ns(void)
+{
+    /* CPU time of the calling thread. phases begin and end on the same thread */
+#if defined(_WIN32)
+    FILETIME creation, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exited, &kernel, &user)) return 0;
+    return ((((uint64_t) kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+            (((uint64_t) user.dwHighDateTime << 32) | user.dwLowDateTime)) * 100u;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#else
+    return (uint64_t) clock() * (1000000000u / CLOCKS_PER_SEC);
+#endif
+}
+
+static void
+stats_end(run_stats *s)
+{
+    enum run_phase phase = s->phase;
+    uint64_t wall;
+    if (phase == PHASE_NONE) return;
+    wall = stats_wall_ns() - s->start_wall;
+    s->wall[phase] += wall;
+    s->cpu[phase] += stats_cpu_ns() - s->start_cpu;
+    s->phase = PHASE_NONE;
+#if defined(EVERMIZER_SDT)
+    DTRACE_PROBE3(pyevermizer, phase__end, (int) phase, run_phase_names[phase], wall);
+#endif
+}
+
+static void
+stats_begin(run_stats *s, enum run_phase phase)
+{
+    stats_end(s);
+#if defined(EVERMIZER_SDT)
+    DTRACE_PROBE2(pyevermizer, phase__begin, (int) phase, run_phase_names[phase]);
+#endif
+    s->phase = phase;
+    s->start_wall = stats_wall_ns();
+    s->start_cpu = stats_cpu_ns();
+}
+
+static int
+stats_fill_dict(const run_stats *s, int result, PyObject *dict)
+{
+    /* {"phases": {name: {"wall": s, "cpu": s}}, "bytes_read", "bytes_written", "log_lines", "native", "result"} */
+    PyObject *phases = PyDict_New();
+    PyObject *o;
+    int res = -1;
+    if (!phases) return -1;
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        o = Py_BuildValue("{sdsd}", "wall", (double) s->wall[i] / 1e9, "cpu", (double) s->cpu[i] / 1e9);
+        if (!o || PyDict_SetItemString(phases, run_phase_names[i], o) < 0) {
+            Py_XDECREF(o);
+            goto cleanup;
+        }
+        Py_DECREF(o);
+    }
+    if (PyDict_SetItemString(dict, "phases", phases) < 0) goto cleanup;
+    o = Py_BuildValue("{sKsKs{snsn}s{sLsL}si}", "bytes_read", (unsigned long long) s->bytes_read,
+                      "bytes_written", (unsigned long long) s->bytes_written,
+                      "log_lines", "stdout", (Py_ssize_t) s->stdout_lines, "stderr", (Py_ssize_t) s->stderr_lines,
+                      "native", "current", (long long) s->native_bytes, "peak", (long long) s->native_peak,
+                      "result", result);
+    if (!o) goto cleanup;
+    res = PyDict_Update(dict, o);
+    Py_DECREF(o);
+cleanup:
+    Py_DECREF(phases);
+    return res;
+}
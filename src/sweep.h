@@ -0,0 +1,233 @@
+#pragma once
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*** reachability over blank_check_tree ***/
+
+/* checks waiting on each progression, built once at module init */
+typedef struct {
+    size_t num_progressions; /* highest progression used in the tables + 1 */
+    size_t num_checks;
+    size_t *waiter_start;    /* per progression, into waiters. num_progressions + 1 entries */
+    uint32_t *waiters;       /* indices into checks */
+    pos_index check_pos;     /* (type, index) -> index into checks */
+    struct check_tree_item *checks; /* copy of blank_check_tree, so sweeps don't read evermizer's globals */
+} logic_graph;
+
+static void
+logic_graph_free(logic_graph *g)
+{
+    PyMem_Free(g->waiter_start);
+    PyMem_Free(g->waiters);
+    PyMem_Free(g->checks);
+    pos_index_free(&g->check_pos);
+    memset(g, 0, sizeof(*g));
+}
+
+static size_t
+count_requirements(const struct check_tree_item *check)
+{
+    size_t n = 0;
+    while (n < ARRAY_SIZE(check->requires) && check->requires[n].progress != P_NONE && check->requires[n].pieces != 0)
+        n++;
+    return n;
+}
+
+static size_t
+count_providers(const struct progression_provider *first, size_t len)
+{
+    size_t n = 0;
+    while (n < len && first[n].progress != P_NONE && first[n].pieces != 0) n++;
+    return n;
+}
+
+static bool
+logic_graph_init(logic_graph *g)
+{
+    size_t max = P_NONE;
+    size_t edges = 0;
+    size_t *fill;
+    memset(g, 0, sizeof(*g));
+    g->num_checks = ARRAY_SIZE(blank_check_tree);
+    g->checks = (struct check_tree_item*) PyMem_Malloc(sizeof(blank_check_tree));
+    if (!g->checks) return false;
+    memcpy(g->checks, blank_check_tree, sizeof(blank_check_tree));
+
+    /* evermizer has no progression count, use what the tables reference */
+    for (size_t i = 0; i < g->num_checks; i++) {
+        const struct check_tree_item *check = g->checks + i;
+        for (size_t k = 0; k < count_requirements(check); k++)
+            if ((size_t) check->requires[k].progress > max) max = (size_t) check->requires[k].progress;
+        for (size_t k = 0; k < count_providers(check->provides, ARRAY_SIZE(check->provides)); k++)
+            if ((size_t) check->provides[k].progress > max) max = (size_t) check->provides[k].progress;
+        edges += count_requirements(check);
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(drops); i++) {
+        for (size_t k = 0; k < count_providers(drops[i].provides, ARRAY_SIZE(drops[i].provides)); k++)
+            if ((size_t) drops[i].provides[k].progress > max) max = (size_t) drops[i].provides[k].progress;
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(extra_data); i++) {
+        for (size_t k = 0; k < count_providers(extra_data[i].provides, ARRAY_SIZE(extra_data[i].provides)); k++)
+            if ((size_t) extra_data[i].provides[k].progress > max) max = (size_t) extra_data[i].provides[k].progress;
+    }
+    g->num_progressions = max + 1;
+
+    /* group checks by required progression */
+    g->waiter_start = (size_t*) PyMem_Calloc(g->num_progressions + 1, sizeof(*g->waiter_start));
+    g->waiters = (uint32_t*) PyMem_Calloc(edges + 1, sizeof(*g->waiters));
+    fill = (size_t*) PyMem_Calloc(g->num_progressions, sizeof(*fill));
+    if (!g->waiter_start || !g->waiters || !fill || !pos_index_init(&g->check_pos, g->num_checks)) {
+        PyMem_Free(fill);
+        logic_graph_free(g);
+        return false;
+    }
+    for (size_t i = 0; i < g->num_checks; i++) {
+        const struct check_tree_item *check = g->checks + i;
+        for (size_t k = 0; k < count_requirements(check); k++) g->waiter_start[check->requires[k].progress + 1]++;
+        pos_index_put(&g->check_pos, check->type, check->index, (uint32_t) i);
+    }
+    for (size_t p = 0; p < g->num_progressions; p++) g->waiter_start[p + 1] += g->waiter_start[p];
+    for (size_t i = 0; i < g->num_checks; i++) {
+        const struct check_tree_item *check = g->checks + i;
+        for (size_t k = 0; k < count_requirements(check); k++) {
+            size_t p = (size_t) check->requires[k].progress;
+            g->waiters[g->waiter_start[p] + fill[p]++] = (uint32_t) i;
+        }
+    }
+    PyMem_Free(fill);
+    return true;
+}
+
+static bool
+check_satisfied(const struct check_tree_item *check, const long *counts)
+{
+    for (size_t k = 0; k < count_requirements(check); k++) {
+        if (counts[check->requires[k].progress] < check->requires[k].pieces) return false;
+    }
+    return true;
+}
+
+/* scratch space for propagation, sized for one entry per check */
+typedef struct {
+    uint32_t *queue;   /* ring buffer of checks to evaluate */
+    bool *queued;
+    size_t head, tail;
+    uint32_t *changed; /* checks that became reachable during logic_propagate */
+    size_t num_changed;
+    uint32_t *deleted; /* checks removed during logic_retract */
+    size_t num_deleted;
+} logic_work;
+
+static void
+logic_work_free(logic_work *w)
+{
+    PyMem_RawFree(w->queue);
+    PyMem_RawFree(w->queued);
+    PyMem_RawFree(w->changed);
+    PyMem_RawFree(w->deleted);
+    memset(w, 0, sizeof(*w));
+}
+
+static bool
+logic_work_init(logic_work *w, const logic_graph *g)
+{
+    memset(w, 0, sizeof(*w));
+    w->queue = (uint32_t*) PyMem_RawMalloc((g->num_checks + 1) * sizeof(*w->queue));
+    w->queued = (bool*) PyMem_RawCalloc(g->num_checks + 1, sizeof(*w->queued));
+    w->changed = (uint32_t*) PyMem_RawMalloc((g->num_checks + 1) * sizeof(*w->changed));
+    w->deleted = (uint32_t*) PyMem_RawMalloc((g->num_checks + 1) * sizeof(*w->deleted));
+    if (!w->queue || !w->queued || !w->changed || !w->deleted) {
+        logic_work_free(w);
+        return false;
+    }
+    return true;
+}
+
+static void
+logic_work_push(logic_work *w, const logic_graph *g, uint32_t i)
+{
+    /* every check is queued at most once, so the ring never overflows */
+    if (w->queued[i]) return;
+    w->queue[w->tail] = i;
+    w->tail = (w->tail + 1) % (g->num_checks + 1);
+    w->queued[i] = true;
+}
+
+static void
+logic_work_wake(logic_work *w, const logic_graph *g, size_t progress, const bool *reached)
+{
+    /* queue checks waiting on progress */
+    for (size_t k = g->waiter_start[progress]; k < g->waiter_start[progress + 1]; k++) {
+        if (!reached[g->waiters[k]]) logic_work_push(w, g, g->waiters[k]);
+    }
+}
+
+static void
+logic_propagate(logic_work *w, const logic_graph *g, long *counts, bool *reached)
+{
+    /* evaluate queued checks until the queue is empty. reached checks add their provides to counts and
+       queue the checks waiting on them. newly reached checks are appended to w->changed */
+    w->num_changed = 0;
+    while (w->head != w->tail) {
+        uint32_t i = w->queue[w->head];
+        const struct check_tree_item *check = g->checks + i;
+        w->head = (w->head + 1) % (g->num_checks + 1);
+        w->queued[i] = false;
+        if (reached[i] || !check_satisfied(check, counts)) continue;
+        reached[i] = true;
+        w->changed[w->num_changed++] = i;
+        for (size_t k = 0; k < count_providers(check->provides, ARRAY_SIZE(check->provides)); k++) {
+            counts[check->provides[k].progress] += check->provides[k].pieces;
+            logic_work_wake(w, g, (size_t) check->provides[k].progress, reached);
+        }
+    }
+}
+
+static void
+logic_retract_waiters(logic_work *w, const logic_graph *g, size_t progress, bool *reached)
+{
+    /* take back every reached check waiting on progress, whether it is still satisfied or not */
+    for (size_t k = g->waiter_start[progress]; k < g->waiter_start[progress + 1]; k++) {
+        uint32_t i = g->waiters[k];
+        if (!reached[i]) continue;
+        reached[i] = false;
+        w->deleted[w->num_deleted++] = i;
+    }
+}
+
+static void
+logic_retract(logic_work *w, const logic_graph *g, long *counts, bool *reached, const size_t *progress, size_t n)
+{
+    /* counts of the given progressions were lowered. over-delete every reached check that depends on them,
+       then re-derive what is still reachable from the remaining counts, so checks that only supported each
+       other in a cycle are not kept. w->deleted lists the checks taken out, those not reached again are lost */
+    w->num_deleted = 0;
+    for (size_t k = 0; k < n; k++) logic_retract_waiters(w, g, progress[k], reached);
+    for (size_t d = 0; d < w->num_deleted; d++) {
+        const struct check_tree_item *check = g->checks + w->deleted[d];
+        for (size_t k = 0; k < count_providers(check->provides, ARRAY_SIZE(check->provides)); k++) {
+            counts[check->provides[k].progress] -= check->provides[k].pieces;
+            logic_retract_waiters(w, g, (size_t) check->provides[k].progress, reached);
+        }
+    }
+    for (size_t d = 0; d < w->num_deleted; d++) logic_work_push(w, g, w->deleted[d]);
+    logic_propagate(w, g, counts, reached);
+}
+
+static bool
+logic_sweep(const logic_graph *g, long *counts, bool *reached)
+{
+    /* collect everything reachable with counts to a fixpoint. counts has num_progressions entries and is
+       updated with what reached checks provide. reached has num_checks entries, checks already set are
+       treated as collected. only checks waiting on a progression that grew are re-evaluated */
+    logic_work w;
+    if (!logic_work_init(&w, g)) return false;
+    for (size_t i = 0; i < g->num_checks; i++) {
+        if (!reached[i]) logic_work_push(&w, g, (uint32_t) i);
+    }
+    logic_propagate(&w, g, counts, reached);
+    logic_work_free(&w);
+    return true;
+}